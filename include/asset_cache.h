@@ -0,0 +1,65 @@
+#ifndef ASSET_CACHE_HEADER_DEFINED
+#define ASSET_CACHE_HEADER_DEFINED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+* Content addressed store for everything the import stages derive from a
+* source file: baked meshes (with their optimized and simplified index
+* buffers), compressed mip chains and linked program binaries.
+*
+* An artifact is named by a 128 bit hash of the bytes it was built from
+* chained with the settings of the stage that built it, so an edited
+* source or a changed setting simply misses, and the same content is
+* shared no matter which file it came from:
+*   ASSET_CACHE_DIR/<key><extension of the kind>
+*
+* Artifacts are written to a temporary file and renamed in place. A hit
+* bumps the modification time of the artifact, and every write evicts
+* the least recently used ones until the directory fits in
+* ASSET_CACHE_MAX_SIZE again.
+*/
+
+#define ASSET_CACHE_DIR ".asset_cache"
+#define ASSET_CACHE_MAX_SIZE ((uint64_t)1 << 30)
+
+typedef struct {
+  uint64_t lo;
+  uint64_t hi;
+} AssetKey;
+
+typedef enum {
+  ASSET_MESH,
+  ASSET_TEXTURE,
+  ASSET_PROGRAM,
+  N_ASSET_KINDS
+} AssetKind;
+
+// 128 bit hash of `size` bytes, chained onto `seed`. Hash the source
+// first and the settings after it, starting from a zero seed.
+AssetKey hashAsset(const void* data, size_t size, AssetKey seed);
+
+// the path of the artifact, false when it does not fit into `n`
+bool assetPath(char* path, size_t n, AssetKind kind, AssetKey key);
+
+// records the outcome of a lookup, a hit also marks `path` as recently
+// used
+void assetHit(AssetKind kind, const char* path, size_t size);
+void assetMiss(AssetKind kind);
+
+// a temporary file to write the artifact for `path` into, NULL when the
+// cache directory can not be created
+FILE* beginAsset(const char* path, char* tmp_path, size_t n);
+// closes `f` and moves it in place when `ok`, then evicts down to the
+// size limit. False when the artifact was not stored.
+bool endAsset(
+    AssetKind kind, FILE* f, const char* tmp_path, const char* path, bool ok
+);
+
+// hits, misses and writes of this run and what the directory holds
+void printAssetCacheStats(void);
+
+#endif
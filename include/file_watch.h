@@ -0,0 +1,46 @@
+#ifndef FILE_WATCH_HEADER_DEFINED
+#define FILE_WATCH_HEADER_DEFINED
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/*
+* Watches files for changes with inotify on a background thread.
+* The parent directory of every file is watched rather than the file
+* itself, so editors that save by writing a new file and renaming it over
+* the old one are noticed as well. Changes are collected as the ids the
+* files were registered with, and handed to the main loop between frames.
+*/
+
+#define MAX_WATCHED_FILES 32
+#define MAX_FILE_NAME 256
+
+typedef struct {
+  int wd; // watch of the parent directory
+  int id;
+  char name[MAX_FILE_NAME];
+} WatchedFile;
+
+typedef struct {
+  int fd;      // inotify instance
+  int wake[2]; // pipe that ends the thread
+  pthread_t thread;
+
+  pthread_mutex_t lock;
+  WatchedFile files[MAX_WATCHED_FILES];
+  int n_files;
+  int changed[MAX_WATCHED_FILES]; // ids, each at most once
+  int n_changed;
+} FileWatcher;
+
+// NULL when inotify is not available
+FileWatcher* createFileWatcher(void);
+void destroyFileWatcher(FileWatcher* watcher);
+
+// reports changes of `path` as `id`, several files may share an id
+bool watchFile(FileWatcher* watcher, const char* path, int id);
+// moves the ids changed since the last call into `ids`, which has room
+// for MAX_WATCHED_FILES. Returns their count.
+int pollFileChanges(FileWatcher* watcher, int* ids);
+
+#endif
@@ -2,15 +2,16 @@
 #define GL_HEADER_DEFINED
 
 #include "glad/gl.h"
+#include "models/meshlet.h"
 #include "models/model.h"
+#include <stdbool.h>
 
 /*
 * Abstraction layer over opengl, adapted for usage in this application.
 * We assume a convention that will be used for all shaders
 */
 
-#define PACKED __attribute__((packed))
-
+// the attribute kinds, doubles as the attribute location in the shaders
 typedef enum {
   VERTEX,
   NORMAL,
@@ -19,25 +20,98 @@ typedef enum {
   N_BUFFER_TYPES
 } BUFFER_TYPE;
 
-// the number of floats in each buffer type
-static const char COMPONENT_SIZE[N_BUFFER_TYPES] = {3, 3, 4, 2};
+// the world transform of each instance, a mat4 over four locations from
+// INSTANCE_LOCATION on, read from its own binding
+#define INSTANCE_LOCATION N_BUFFER_TYPES
+#define INSTANCE_BINDING N_BUFFER_TYPES
+
+typedef enum {
+  // one buffer per attribute
+  LAYOUT_SEPARATE,
+  // positions in their own buffer, such that depth / shadow passes only
+  // fetch positions, and every other attribute interleaved in a second one
+  LAYOUT_INTERLEAVED,
+} VertexLayout;
+
+/// how one attribute is stored in the vertex buffers
+typedef struct {
+  bool enabled;
+  GLint size;           // number of components
+  GLenum type;          // component type
+  GLboolean normalized; // integer types are mapped to [0, 1] / [-1, 1]
+  GLuint binding;       // which vertex buffer the attribute lives in
+  GLuint offset;        // byte offset of the attribute inside a vertex
+} VertexAttribFormat;
+
+/// how the attributes of a mesh are laid out over the vertex buffers
+typedef struct {
+  VertexLayout layout;
+  bool quantized; // see models/quantize.h, for float attributes of the file
+  VertexAttribFormat attribs[N_BUFFER_TYPES];
+  GLsizei stride[N_BUFFER_TYPES]; // per binding
+  int n_bindings;
+} VertexFormat;
+
+typedef struct {
+  // one buffer per attribute, or per binding of the vertex format
+  GLuint buffers[N_BUFFER_TYPES];
+} VBOBuffers;
+
+/// uniforms the vertex shader needs to decode the compact encoding, the
+/// identity transform and no octahedral attributes for the others
+typedef struct {
+  float pos_offset[3];
+  float pos_scale[3];
+  bool oct_normals;
+  bool oct_tangents;
+} VertexDequant;
+
+/// the layout glMultiDrawElementsIndirect reads its commands in
+typedef struct {
+  GLuint count;
+  GLuint instance_count;
+  GLuint first_index;
+  GLint base_vertex;
+  GLuint base_instance;
+} DrawElementsIndirectCommand;
 
+/// consecutive slots of the instance buffer, see `syncInstances`
 typedef struct {
-  GLuint vertices;
-  GLuint normals;
-  GLuint tangent;
-  GLuint texcoord;
-} PACKED VBOBuffers;
+  int first;
+  int count;
+} InstanceRange;
 
-// SOA. groupings of identifiers 
+// SOA. groupings of identifiers
 typedef struct {
-  GLuint* vao; // vertex array ids
-  GLuint* ebo; // vertex buffer ids for indices
-  VBOBuffers* vbo; // vertex buffer ids
+  GLuint* vao;            // vertex array ids
+  GLuint* ebo;            // vertex buffer ids for indices
+  VBOBuffers* vbo;        // vertex buffer ids
+  GLuint* indirect;       // draw command buffer ids, for meshlet draws
+  VertexDequant* dequant; // filled by `syncBuffers`
+  GLuint instances;       // instance transforms, shared by the meshes
+  VertexLayout layout;
+  bool quantized; // upload the compact vertex encoding
 } GlIdentifier;
 
+// the format `syncBuffers` uploads `m` with
+VertexFormat
+meshVertexFormat(const Mesh* m, VertexLayout layout, bool quantized);
 
-void genGlIds(GlIdentifier* ids, int n);
+void genGlIds(GlIdentifier* ids, int n, VertexLayout layout, bool quantize);
 void syncBuffers(Mesh* m, GlIdentifier* ids, int n);
+// replaces the instance transforms, `n` column major float[16]
+void syncInstances(GlIdentifier* ids, const float* matrices, int n);
+// one instance, with the transform in the first slot
+void drawMesh(const Mesh* m, GlIdentifier* ids, int i);
+// draws level `lod` of the mesh once per instance, see models/lod.h
+void drawMeshLod(
+    const Mesh* m, GlIdentifier* ids, int i, int lod, InstanceRange instances
+);
+// draws the full resolution ranges from `cullMeshlets` with one call
+void drawMeshlets(
+    const Mesh* m, GlIdentifier* ids, int i, InstanceRange instances,
+    const MeshletRange* ranges, int n_ranges
+);
+void freeGlIds(GlIdentifier* ids, int n);
 
 #endif
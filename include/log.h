@@ -0,0 +1,26 @@
+#ifndef LOG_HEADER_DEFINED
+#define LOG_HEADER_DEFINED
+
+#include <stdio.h>
+
+/*
+* Compile time log levels. Messages above LOG_LEVEL are still type checked
+* but compiled out, set it with -DLOG_LEVEL=... to see more.
+*/
+
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_DEBUG 2 // per mesh, primitive and attribute
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG(level, ...)                                                        \
+  do {                                                                         \
+    if ((level) <= LOG_LEVEL) printf(__VA_ARGS__);                             \
+  } while (0)
+#define LOG_INFO(...) LOG(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef BOUNDS_HEADER_DEFINED
+#define BOUNDS_HEADER_DEFINED
+
+#include "models/model.h"
+
+/*
+* Object space bounds of a mesh, computed once at import and baked into the
+* mesh cache, so culling, level of detail and quantization never rescan
+* the vertices.
+*
+* The sphere is centered on the box. When the box comes from the file
+* (gltf accessor min / max) the vertices are not read at all and the
+* sphere is the one around the box, otherwise a second pass over the
+* vertices tightens the radius.
+*/
+
+// box of `n` packed vec3, all zero when `n` is 0
+void boundingBox(const float* p, int n, float min[3], float max[3]);
+// the bounds of the positions of `m`
+void computeMeshBounds(Mesh* m);
+// the bounds of a box given by the file, the vertices are not read
+void meshBoundsFromBox(Mesh* m, const float min[3], const float max[3]);
+
+#endif
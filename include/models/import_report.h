@@ -0,0 +1,80 @@
+#ifndef IMPORT_REPORT_HEADER_DEFINED
+#define IMPORT_REPORT_HEADER_DEFINED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+* Where the time of a model import goes, filled by `loadModel` when asked
+* for and written out as a single JSON object.
+*
+* Every phase has a wall clock span and the cpu time of every thread that
+* worked on it. The images, attributes and indices run as tasks at the
+* same time, so their spans overlap and do not add up to the total.
+* The frames phase fans out on its own and is timed from the loading
+* thread, so its cpu time is that of the loading thread alone.
+*/
+
+typedef enum {
+  PHASE_CACHE_LOAD,  // hashing the source and mapping a baked mesh
+  PHASE_PARSE,       // gltf json
+  PHASE_VALIDATE,    // cgltf_validate
+  PHASE_BUFFERS,     // resolving the buffers
+  PHASE_DECOMPRESS,  // EXT_meshopt_compression buffer views
+  PHASE_SCENE,       // node hierarchy and transforms
+  PHASE_IMAGES,      // image decoding
+  PHASE_ATTRIBUTES,  // attribute unpacking
+  PHASE_INDICES,     // index unpacking and conversion
+  PHASE_FRAMES,      // generated normals and tangents
+  PHASE_OPTIMIZE,    // vertex reordering, lods and meshlets
+  PHASE_CACHE_WRITE, // baking the mesh cache
+  N_IMPORT_PHASES
+} ImportPhase;
+
+// bytes produced by the import, per kind of data
+typedef enum {
+  DATA_POSITIONS,
+  DATA_NORMALS,
+  DATA_TANGENTS,
+  DATA_TEX_COORDS,
+  DATA_INDICES,
+  DATA_IMAGES,
+  N_IMPORT_DATA
+} ImportData;
+
+// the wall clock and the cpu time of the calling thread, in seconds
+typedef struct {
+  double wall;
+  double cpu;
+} ClockReading;
+
+typedef struct {
+  double begin; // wall clock span, both 0 when the phase did not run
+  double end;
+  double cpu; // summed over threads
+} PhaseTime;
+
+typedef struct {
+  const char* path;
+  bool success;
+  bool cached; // loaded from the mesh cache, the gltf phases did not run
+  int n_meshes;
+  int n_nodes;
+  int n_images; // decoded, 0 when cached
+  PhaseTime total;
+  PhaseTime phases[N_IMPORT_PHASES];
+  uint64_t bytes[N_IMPORT_DATA];
+} ImportReport;
+
+ClockReading readClock(void);
+// widens `phase` to cover a span that was measured on one thread
+void addPhaseTime(PhaseTime* phase, ClockReading begin, ClockReading end);
+// adds the span from `begin` until now to `phase`, and returns now
+ClockReading endPhase(
+    ImportReport* report, ImportPhase phase, ClockReading begin
+);
+
+void writeImportReport(const ImportReport* report, FILE* f);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef LOD_HEADER_DEFINED
+#define LOD_HEADER_DEFINED
+
+#include "models/model.h"
+#include <stdint.h>
+
+/*
+* Level of detail chain of a mesh. Each level halves the triangle count of
+* the previous one with quadric error edge collapses, and shares the vertex
+* buffer of the full mesh, so a level is only a second index list.
+* Vertices on open borders and uv / normal seams are never moved.
+*/
+
+// no levels are built below this many triangles
+#define LOD_MIN_TRIANGLES 64
+// a level that keeps more than this fraction of the previous one is
+// not worth its memory, and ends the chain
+#define LOD_MIN_REDUCTION 0.8f
+
+// fills `m->lods` with index lists from `arena`, the mesh itself is left
+// untouched
+void generateMeshLods(Mesh* m, Arena* arena);
+
+// simplifies `indices` towards `target` indices into `out`, which has room
+// for `n_indices`. Returns the index count and the introduced deviation.
+int simplifyMesh(
+    const float* positions, int n_vertices, const uint32_t* indices,
+    int n_indices, int target, uint32_t* out, float* error
+);
+
+// pixels per object space unit at distance 1
+float lodErrorScale(float fov_y, int viewport_height);
+// the coarsest level whose error projects to at most `max_pixels`
+int selectMeshLod(
+    const Mesh* m, float distance, float error_scale, float max_pixels
+);
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef MESH_CACHE_HEADER_DEFINED
+#define MESH_CACHE_HEADER_DEFINED
+
+#include "asset_cache.h"
+#include "models/model.h"
+#include <stdint.h>
+
+/*
+* Baked binary cache of a loaded `Model`, stored in the asset cache under
+* the hash of the source file and the import settings, see asset_cache.h.
+*
+* The file holds the final, already transformed mesh and image payloads,
+* each aligned to MESH_CACHE_ALIGNMENT, so loading it is a single mmap
+* followed by pointing the `Mesh` / `ImageData` fields into the mapping.
+* Nothing is parsed or decoded, and the pointers can be handed directly to
+* glBufferData / glTexImage2D.
+*
+* Layout:
+*   CacheHeader
+*   CacheMesh[n_meshes]
+*   CacheImage[n_materials]
+*   CacheNode[n_nodes]
+*   float[n_instance_transforms][16], see `Scene.instance_transforms`
+*   payload blobs, each starting on a MESH_CACHE_ALIGNMENT boundary
+*/
+
+#define MESH_CACHE_MAGIC 0x48534d4c // "LMSH"
+#define MESH_CACHE_VERSION 13
+#define MESH_CACHE_ALIGNMENT 64
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  AssetKey key; // the file was baked for, guards against a renamed file
+  uint32_t n_meshes;
+  uint32_t n_materials;
+  uint32_t n_nodes;
+  uint32_t n_instance_transforms;
+} CacheHeader;
+
+typedef enum {
+  CACHE_VERTICES,
+  CACHE_NORMALS,
+  CACHE_TANGENTS,
+  CACHE_TEX_COORDS,
+  CACHE_INDICES,
+  CACHE_MESHLETS,
+  CACHE_LOD_INDICES, // one blob per level, see `MeshLod`
+  N_CACHE_BLOBS = CACHE_LOD_INDICES + MAX_MESH_LODS
+} CacheBlob;
+
+// offsets are from the start of the file, 0 means the attribute is missing
+typedef struct {
+  int32_t n_vertices;
+  int32_t n_triangles;
+  int32_t index_type; // `IndexType` of all index blobs
+  int32_t n_lods;
+  int32_t lod_triangles[MAX_MESH_LODS];
+  float lod_error[MAX_MESH_LODS];
+  int32_t n_meshlets;
+  int32_t _pad;
+  MeshBounds bounds;
+  // `AttributeFormat` of each attribute, and the encoding of its blob
+  uint8_t component_type[N_MESH_ATTRIBUTES];
+  uint8_t normalized[N_MESH_ATTRIBUTES];
+  uint64_t offset[N_CACHE_BLOBS];
+} CacheMesh;
+
+typedef struct {
+  int32_t w;
+  int32_t h;
+  int32_t format;
+  int32_t _pad;
+  uint64_t offset;
+} CacheImage;
+
+// a `SceneNode`, the world transform is recomputed on load and the first
+// instance follows from the nodes before
+typedef struct {
+  int32_t parent;
+  int32_t first_mesh;
+  int32_t n_meshes;
+  int32_t n_instances;
+  float local[16];
+} CacheNode;
+
+LoadModelRes writeModelCache(const char* path, AssetKey key, Model* model);
+LoadModelRes loadModelFromCache(
+    const char* path, AssetKey key, Model* model
+);
+void releaseModelCache(Model* model);
+
+// loads `path` through the cache when it was baked before, otherwise
+// loads the gltf file and bakes it for the next start. Fills `report`
+// when it is not NULL.
+LoadModelRes loadModel(
+    const char* path, Model* model, ImportReport* report
+);
+
+#endif
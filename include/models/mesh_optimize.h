@@ -0,0 +1,47 @@
+#ifndef MESH_OPTIMIZE_HEADER_DEFINED
+#define MESH_OPTIMIZE_HEADER_DEFINED
+
+#include "models/model.h"
+#include <stdint.h>
+
+/*
+* Load time reordering of meshes, such that every later frame does less work:
+*   1. triangles are reordered for the post-transform vertex cache
+*      (Forsyth's linear-speed algorithm)
+*   2. clusters of that order are sorted outside-in to reduce overdraw,
+*      keeping the order inside each cluster intact
+*   3. vertices are renumbered in first-use order for fetch locality,
+*      unreferenced vertices are dropped
+*/
+
+// the cache the analysis simulates, a typical FIFO post-transform cache
+#define ANALYZE_CACHE_SIZE 16
+
+typedef struct {
+  float acmr; // average cache misses per triangle, 0.5 - 3
+  float atvr; // average transformed vertices per vertex, >= 1
+} VertexCacheStats;
+
+typedef struct {
+  VertexCacheStats before;
+  VertexCacheStats after;
+} MeshOptStats;
+
+// a 32 bit copy of the indices of `m`, NULL if it has none
+uint32_t* widenIndices(const Mesh* m);
+
+// runs all passes on an indexed mesh, non-indexed meshes are left as is
+MeshOptStats optimizeMesh(Mesh* m);
+
+VertexCacheStats
+analyzeVertexCache(const uint32_t* indices, int n_indices, int n_vertices);
+
+// the individual passes, working in place on 32 bit index lists
+void optimizeVertexCache(uint32_t* indices, int n_indices, int n_vertices);
+void optimizeOverdraw(
+    uint32_t* indices, int n_indices, const float* positions, int n_vertices
+);
+// returns the new vertex count
+int optimizeVertexFetch(Mesh* m, uint32_t* indices, int n_indices);
+
+#endif
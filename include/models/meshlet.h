@@ -0,0 +1,36 @@
+#ifndef MESHLET_HEADER_DEFINED
+#define MESHLET_HEADER_DEFINED
+
+#include "models/model.h"
+
+/*
+* Meshlets are small clusters of consecutive triangles of a mesh. They are
+* cut from the (already cache optimized) index list as it is, so a meshlet
+* is a range of the index buffer and no indices are duplicated.
+* Each meshlet carries a bounding sphere and a normal cone, such that whole
+* clusters can be culled against the frustum and for backfacing on the cpu.
+*/
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// a range of triangles to draw
+typedef struct {
+  int first_triangle;
+  int n_triangles;
+} MeshletRange;
+
+// fills `m->meshlets` from the full resolution index list, allocating
+// from `arena`
+void buildMeshlets(Mesh* m, Arena* arena);
+
+// the visible meshlets of `m` as ranges, adjacent meshlets are merged.
+// `planes` are the frustum planes in object space (xyz normal pointing
+// inwards, w distance), `eye` the viewer in object space.
+// `out` has room for `m->n_meshlets` ranges, returns the number written.
+int cullMeshlets(
+    const Mesh* m, float planes[6][4], const float eye[3],
+    MeshletRange* out
+);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef MESHOPT_DECODE_HEADER_DEFINED
+#define MESHOPT_DECODE_HEADER_DEFINED
+
+#include <cgltf/cgltf.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+* Decoders for buffer views compressed with EXT_meshopt_compression.
+*
+* A compressed view is decoded once, right after the buffers are loaded,
+* into `view->data`. cgltf reads every accessor through that pointer and
+* frees it with the rest of the file, so the loader is otherwise unchanged.
+*
+* The three bitstreams of the extension are supported:
+*   attributes - byte wise deltas between consecutive vertices, packed in
+*                groups of 16 with 0, 2, 4 or 8 bits per byte
+*   triangles  - edge and vertex fifo codes with an auxiliary table
+*   indices    - zigzag varint deltas against two baselines
+* followed by the octahedral, quaternion and exponential filters.
+*
+* The byte groups are unpacked with SSSE3 shuffles when the cpu has them,
+* checked at run time, and the deltas are summed four channels at a time
+* with SSE2. Both have a scalar fallback.
+*/
+
+// every decoder returns false when the stream is malformed or does not
+// match the expected size
+bool decodeMeshoptVertices(
+    void* dst, size_t count, size_t stride, const uint8_t* src, size_t size
+);
+bool decodeMeshoptTriangles(
+    void* dst, size_t count, size_t index_size, const uint8_t* src,
+    size_t size
+);
+bool decodeMeshoptIndices(
+    void* dst, size_t count, size_t index_size, const uint8_t* src,
+    size_t size
+);
+
+// the filters run in place on decoded attributes
+void meshoptFilterOctahedral(void* data, size_t count, size_t stride);
+void meshoptFilterQuaternion(void* data, size_t count, size_t stride);
+void meshoptFilterExponential(void* data, size_t count, size_t stride);
+
+// decodes and filters a compressed view into a new `view->data`, which
+// cgltf_free releases. Touches nothing but `view`, so views can be
+// decoded in parallel.
+bool decodeMeshoptView(cgltf_buffer_view* view);
+
+#endif
@@ -3,8 +3,75 @@
 
 #include "glad/gl.h"
 #include <cgltf/cgltf.h>
+#include "arena.h"
+#include "models/import_report.h"
+#include "models/scene.h"
 #include "util.h"
 
+// the width of the indices of a mesh. 32 bit is the zero value, such that
+// meshes without an explicit type keep working as before
+typedef enum {
+  INDEX_U32,
+  INDEX_U16,
+  INDEX_U8,
+  N_INDEX_TYPES
+} IndexType;
+
+// simplified versions of a mesh, see models/lod.h
+#define MAX_MESH_LODS 4
+
+typedef struct {
+  int n_triangles;
+  float error;   // object space deviation from the full mesh
+  void* indices; // into the vertices of the mesh, `index_type` wide
+} MeshLod;
+
+// a cluster of consecutive triangles, see models/meshlet.h
+typedef struct {
+  int first_triangle;
+  int n_triangles;
+  // bounding sphere, object space
+  float center[3];
+  float radius;
+  // every triangle faces away from a viewer at `eye` when
+  // dot(normalize(apex - eye), axis) >= cutoff
+  float cone_apex[3];
+  float cone_axis[3];
+  float cone_cutoff; // 1 or more when the cone is too wide to cull
+} Meshlet;
+
+// the component type of an attribute in its file. Besides float,
+// KHR_mesh_quantization allows 8 and 16 bit integers, read as is or
+// normalized to [0, 1] / [-1, 1]. Float is the zero value, such that
+// generated attributes need no format.
+typedef enum {
+  COMPONENT_F32,
+  COMPONENT_I8,
+  COMPONENT_U8,
+  COMPONENT_I16,
+  COMPONENT_U16,
+  N_COMPONENT_TYPES
+} ComponentType;
+
+// how an attribute was stored in the file. A `Mesh` keeps attributes
+// that are not float in that encoding, such that the gpu and the mesh
+// cache get them as they were stored, see gl_util.h
+typedef struct {
+  ComponentType type;
+  bool normalized;
+} AttributeFormat;
+
+// the attribute arrays of a mesh: vertices, normals, tangents, tex_coords
+#define N_MESH_ATTRIBUTES 4
+
+// object space bounds of the positions, see models/bounds.h
+typedef struct {
+  float min[3];
+  float max[3];
+  float center[3];
+  float radius;
+} MeshBounds;
+
 typedef struct {
   int n_vertices;
   int n_triangles;
@@ -12,7 +79,20 @@ typedef struct {
   float* normals;
   float* tangents;
   float* tex_coords;
-  unsigned int* indices;
+  AttributeFormat formats[N_MESH_ATTRIBUTES]; // of the arrays above
+  // the attributes whose format is not float, in their file encoding with
+  // every vertex padded to 4 bytes (see `encodeComponents`). Their float
+  // arrays above are only set while importing.
+  void* encoded[N_MESH_ATTRIBUTES];
+  void* indices; // `index_type` wide
+  IndexType index_type;
+  MeshBounds bounds;
+  // coarser levels, the full mesh is level 0 and lods[0] level 1
+  int n_lods;
+  MeshLod lods[MAX_MESH_LODS];
+  // clusters of the full mesh, NULL when not built
+  int n_meshlets;
+  Meshlet* meshlets;
 } Mesh;
 
 typedef enum {
@@ -50,8 +130,20 @@ typedef struct {
   int n_materials;
   Mesh* meshes;
   Material* materials;
+  // the nodes placing the meshes, see models/scene.h
+  Scene scene;
+  // set when the mesh and image data points into a mapped mesh cache
+  // (see models/mesh_cache.h). Such data is read only.
+  void* mapping;
+  size_t mapping_size;
+  // owns the meshes and materials, and every array they point to that is
+  // not in the mapping
+  Arena arena;
 } Model;
 
+// alignment of the arrays of a model, enough for any simd load and upload
+#define MODEL_ALIGNMENT 64
+
 
 typedef enum {
   SUCCESS,
@@ -59,10 +151,35 @@ typedef enum {
 } LoadModelRes;
 
 int format_to_gl_const(ImageFormat format);
+int index_type_to_gl_const(IndexType type);
+int component_type_to_gl_const(ComponentType type);
+// bytes per component
+int componentSize(ComponentType type);
+// attribute `k` of `m` (vertices, normals, tangents, tex_coords), floats
+// or the encoding of `formats[k]`. NULL when the mesh has none
+const void* meshAttribute(const Mesh* m, int k);
+// bytes per vertex of `meshAttribute`
+int meshAttributeStride(const Mesh* m, int k);
+// bytes per index
+int indexSize(IndexType type);
+// the narrowest index type that can address `n_vertices` vertices
+IndexType narrowIndexType(int n_vertices);
+// converts `n` indices between widths, `dst` may alias `src` when the
+// types are equal or when narrowing
+void copyIndices(
+    void* dst, IndexType dst_type, const void* src, IndexType src_type, int n
+);
+
+// adds the time of every phase to `report` when it is not NULL
+LoadModelRes loadModelFromGltfFile(
+    const char* path, Model* model, ImportReport* report
+);
+
+// `size` bytes from `a`, `align` is a power of two
+void* arenaAllocAligned(Arena* a, size_t size, size_t align);
+// `n` zeroed elements of `size` bytes from `a`, word aligned
+void* arenaCalloc(Arena* a, size_t n, size_t size);
 
-LoadModelRes loadModelFromGltfFile(const char* path, Model* model);
-
-void freeMesh(Mesh* mesh);
 void freeModel(Model* model);
 
 #endif
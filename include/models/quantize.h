@@ -0,0 +1,51 @@
+#ifndef QUANTIZE_HEADER_DEFINED
+#define QUANTIZE_HEADER_DEFINED
+
+#include "models/model.h"
+#include <stdint.h>
+
+/*
+* Compact vertex encoding used for upload, 24 bytes per vertex instead of 48:
+*   positions  - unorm16 x3 (+ pad) relative to the mesh bounding box
+*   normals    - octahedral snorm16 x2
+*   tangents   - octahedral snorm16 x2, handedness as snorm16 (+ pad)
+*   tex_coords - half float x2
+* The matching decode is in shaders/sun.vert.
+*
+* Attributes that were already quantized in the file (KHR_mesh_quantization)
+* are instead kept in their exact file encoding, which the importer
+* restores with `encodeComponents` once it is done with the floats. The
+* vertex fetch normalizes them on its own.
+*/
+
+typedef struct {
+  int n_vertices;
+  // position = pos_offset + unorm * pos_scale
+  float pos_offset[3];
+  float pos_scale[3];
+  uint16_t* positions;  // 4 per vertex
+  int16_t* normals;     // 2 per vertex
+  int16_t* tangents;    // 4 per vertex
+  uint16_t* tex_coords; // 2 per vertex
+} QuantizedMesh;
+
+// attributes missing in `m` stay NULL in `q`
+void quantizeMesh(const Mesh* m, QuantizedMesh* q);
+void freeQuantizedMesh(QuantizedMesh* q);
+
+// the individual encoders, exposed for reuse
+void quantizePositions(
+    const float* src, int n, const float offset[3], const float scale[3],
+    uint16_t* dst
+);
+void encodeOctNormals(const float* src, int n, int16_t* dst);
+void encodeOctTangents(const float* src, int n, int16_t* dst);
+void encodeHalfs(const float* src, int n, uint16_t* dst);
+// the inverse of cgltf_accessor_unpack_floats, `n` vertices of `n_comps`
+// components in `format`. Every vertex is padded to a multiple of four
+// bytes.
+void encodeComponents(
+    const float* src, int n, int n_comps, AttributeFormat format, void* dst
+);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SCENE_HEADER_DEFINED
+#define SCENE_HEADER_DEFINED
+
+#include <stdbool.h>
+
+/*
+* The node hierarchy of a model. Meshes are stored once in the model and
+* referenced by index from the nodes, so a mesh that several nodes use is
+* loaded and uploaded once and its nodes become instances of one draw.
+*
+* Transforms are column major float[16], as cgltf stores them. The local
+* transform of a node is what the file (or an animation) sets, the world
+* transform is derived from the local ones by `updateSceneTransforms`.
+*
+* Nodes with EXT_mesh_gpu_instancing place their meshes once per instance
+* transform of the extension, relative to the node, and not at the node
+* itself. The transforms of all such nodes are stored in one array, each
+* node owning a consecutive range in node order.
+*/
+
+typedef struct {
+  int parent;     // -1 for roots, parents come before their children
+  int first_mesh; // the primitives of the node's mesh, -1 when it has none
+  int n_meshes;
+  int first_instance; // into `Scene.instance_transforms`
+  int n_instances;    // 0 for nodes without EXT_mesh_gpu_instancing
+  float local[16];    // relative to the parent
+  float world[16];
+} SceneNode;
+
+typedef struct {
+  int n_nodes;
+  SceneNode* nodes;
+  int n_instance_transforms;
+  float (*instance_transforms)[16]; // relative to their node
+} Scene;
+
+// the nodes (and instances of instanced nodes) that share one mesh, drawn
+// together
+typedef struct {
+  int mesh;
+  int first_instance; // into the instance arrays
+  int n_instances;
+} SceneBatch;
+
+typedef struct {
+  int n_batches;
+  SceneBatch* batches; // one per mesh that is used by any node
+  int n_instances;
+  int* nodes;           // the node of every instance, grouped by batch
+  int* transforms;       // its instance transform, -1 for the node itself
+  float (*matrices)[16]; // world transform of every instance
+} SceneInstances;
+
+// recomputes every world transform from the local ones
+void updateSceneTransforms(Scene* scene);
+
+// groups the nodes of `scene` by the meshes they use
+bool buildSceneInstances(
+    const Scene* scene, int n_meshes, SceneInstances* instances
+);
+// copies the world transforms of the nodes into `instances->matrices`
+void updateSceneInstances(const Scene* scene, SceneInstances* instances);
+void freeSceneInstances(SceneInstances* instances);
+
+// out = a * b
+void multiplyTransforms(const float a[16], const float b[16], float out[16]);
+// out = translation * rotation * scale, the rotation a quaternion (x, y,
+// z, w)
+void composeTransform(
+    const float translation[3], const float rotation[4], const float scale[3],
+    float out[16]
+);
+
+#endif
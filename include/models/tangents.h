@@ -0,0 +1,32 @@
+#ifndef TANGENTS_HEADER_DEFINED
+#define TANGENTS_HEADER_DEFINED
+
+#include "models/model.h"
+
+/*
+* Generates the normals and tangents that a file left out.
+*
+* Normals are the area weighted average of the faces around a vertex.
+* Tangents follow MikkTSpace: the uv derivatives of every face are
+* weighted by the corner angle at each vertex, orthogonalized against the
+* vertex normal, and the bitangent sign is stored in w. Unlike the
+* reference implementation vertices are never split where the tangent
+* frame flips, exporters already split them along uv seams.
+*
+* The triangles of a mesh are cut into parts that accumulate into sums of
+* their own on the shared pool, a second pass adds the parts up per range
+* of vertices and normalizes.
+*/
+
+// triangles below this are accumulated in a single part
+#define FRAME_PART_TRIANGLES 16384
+// upper bound of parts per mesh, each holds a sum for every vertex
+#define FRAME_MAX_PARTS 8
+
+// fills `normals` of every mesh that has none, then `tangents` of every
+// mesh that has none but has texture coordinates. Storage is allocated
+// from `arena`, a mesh whose sums cannot be allocated is left without the
+// attribute. Runs tasks on the shared pool, so it must not run on one.
+void generateMeshFrames(Mesh* meshes, int n_meshes, Arena* arena);
+
+#endif
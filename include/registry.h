@@ -0,0 +1,61 @@
+#ifndef REGISTRY_HEADER_DEFINED
+#define REGISTRY_HEADER_DEFINED
+
+#include "asset_cache.h"
+#include "gl_util.h"
+#include "textures/texture.h"
+#include "textures/texture_stream.h"
+#include <stdbool.h>
+
+/*
+* Uploaded textures and meshes, shared between every model that loads
+* them. A resource is keyed by a hash of its content, so the same atlas
+* or prop in two files (or twice in one file) is uploaded once. Models
+* hold counted handles, the gpu objects are deleted with the last one.
+*
+* Within a file the loader already decodes every gltf image once, see
+* `loadModelFromGltfFile`.
+*/
+
+typedef enum {
+  RESOURCE_TEXTURE,
+  RESOURCE_MESH,
+} ResourceKind;
+
+typedef struct {
+  AssetKey key;
+  ResourceKind kind;
+  int refs; // 0 marks a free slot
+  GLuint texture;
+  GlIdentifier mesh; // the buffers of a single mesh
+} Resource;
+
+// an index into the registry plus one, 0 is no resource
+typedef int ResourceHandle;
+
+typedef struct {
+  int n_resources;
+  int capacity;
+  Resource* resources;
+} Registry;
+
+// the texture of `image`, uploaded (or streamed when `stream` is set) on
+// first use. The pixels have to outlive a streamed upload.
+ResourceHandle acquireTexture(
+    Registry* registry, const ImageData* image, TextureUsage usage,
+    TextureStream* stream
+);
+// the vertex and index buffers of `m`, uploaded on first use
+ResourceHandle acquireMesh(
+    Registry* registry, const Mesh* m, VertexLayout layout, bool quantize
+);
+void releaseResource(Registry* registry, ResourceHandle handle);
+
+// valid until the next acquire
+GLuint resourceTexture(const Registry* registry, ResourceHandle handle);
+GlIdentifier* resourceMesh(Registry* registry, ResourceHandle handle);
+
+// deletes every resource, handles still held become invalid
+void freeRegistry(Registry* registry);
+
+#endif
@@ -4,6 +4,7 @@
 #include "glad/gl.h"
 #include <GLFW/glfw3.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef const char* ShaderSrc;
 typedef GLuint Shader;
@@ -12,8 +13,26 @@ typedef struct {
   GLint view;
   GLint projection;
   GLint texture_0;
+  // vertex decoding, see models/quantize.h
+  GLint oct_normals;
+  GLint oct_tangents;
+  GLint pos_offset;
+  GLint pos_scale;
 } ShaderVars;
 
+// linked programs are stored in the asset cache with this header in
+// front of the driver's binary, see asset_cache.h
+#define PROGRAM_CACHE_MAGIC 0x47525043 // "CPRG"
+#define PROGRAM_CACHE_VERSION 1
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t format; // binary format of the driver
+  uint32_t size;
+} ProgramCacheHeader;
+
+// compiled and linked, or loaded from the asset cache. 0 on failure.
 GLuint loadShader(const char* v_path, const char* f_path);
 ShaderVars loadShaderVars(GLuint shader);
 
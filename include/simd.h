@@ -0,0 +1,48 @@
+#ifndef SIMD_HEADER_DEFINED
+#define SIMD_HEADER_DEFINED
+
+/*
+* Small SSE helpers shared by the vertex processing kernels.
+* Everything here is only available when compiling with SSE2, callers
+* provide a scalar fallback.
+*
+* Kernels that need more than the baseline of the build (SSSE3, F16C) are
+* compiled for their extension with SIMD_TARGET and picked at run time
+* with __builtin_cpu_supports when SIMD_DISPATCH is set.
+*/
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_DISPATCH 1
+#define SIMD_TARGET(ext) __attribute__((target(ext)))
+#endif
+
+/// {x[i0], x[i1], y[i2], y[i3]}
+#define SHUF(x, y, i0, i1, i2, i3)                                             \
+  _mm_shuffle_ps((x), (y), _MM_SHUFFLE(i3, i2, i1, i0))
+
+/// 4 packed vec3 -> SoA registers
+static inline void
+load3x4(const float* p, __m128* x, __m128* y, __m128* z) {
+  __m128 a = _mm_loadu_ps(p + 0); // x0 y0 z0 x1
+  __m128 b = _mm_loadu_ps(p + 4); // y1 z1 x2 y2
+  __m128 c = _mm_loadu_ps(p + 8); // z2 x3 y3 z3
+  *x       = SHUF(a, SHUF(b, c, 2, 2, 1, 1), 0, 3, 0, 2);
+  *y       = SHUF(SHUF(a, b, 1, 1, 0, 0), SHUF(b, c, 3, 3, 2, 2), 0, 2, 0, 2);
+  *z       = SHUF(SHUF(a, b, 2, 2, 1, 1), c, 0, 2, 0, 3);
+}
+
+/// SoA registers -> 4 packed vec3
+static inline void store3x4(float* p, __m128 x, __m128 y, __m128 z) {
+  __m128 a = SHUF(SHUF(x, y, 0, 0, 0, 0), SHUF(z, x, 0, 0, 1, 1), 0, 2, 0, 2);
+  __m128 b = SHUF(SHUF(y, z, 1, 1, 1, 1), SHUF(x, y, 2, 2, 2, 2), 0, 2, 0, 2);
+  __m128 c = SHUF(SHUF(z, x, 2, 2, 3, 3), SHUF(y, z, 3, 3, 3, 3), 0, 2, 0, 2);
+  _mm_storeu_ps(p + 0, a);
+  _mm_storeu_ps(p + 4, b);
+  _mm_storeu_ps(p + 8, c);
+}
+#endif
+
+#endif
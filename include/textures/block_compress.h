@@ -0,0 +1,56 @@
+#ifndef BLOCK_COMPRESS_HEADER_DEFINED
+#define BLOCK_COMPRESS_HEADER_DEFINED
+
+#include "models/model.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+* CPU encoders for the block compressed texture formats, every 4x4 pixel
+* block becomes 8 or 16 bytes:
+*   BC1 - rgb, 565 endpoints and 2 bit indices          (8 bytes)
+*   BC3 - rgba, a BC4 alpha block followed by BC1 color (16 bytes)
+*   BC5 - rg, two BC4 blocks, for tangent space normals (16 bytes)
+*   BC7 - rgba, mode 6 only: 7.7.7.7 + p-bit endpoints and 4 bit indices
+*         (16 bytes)
+* Endpoints are fit along the principal axis of the block and refined once
+* with least squares. The per pixel loops work on 16 pixel arrays so the
+* compiler can vectorize them.
+*/
+
+typedef enum {
+  BLOCK_BC1,
+  BLOCK_BC3,
+  BLOCK_BC5,
+  BLOCK_BC7,
+  N_BLOCK_FORMATS
+} BlockFormat;
+
+typedef enum {
+  TEXTURE_COLOR,
+  TEXTURE_NORMAL,
+} TextureUsage;
+
+// the format an image of `format` is compressed to
+BlockFormat blockFormatFor(ImageFormat format, TextureUsage usage);
+int block_format_to_gl_const(BlockFormat format);
+
+// bytes per 4x4 block
+int blockSize(BlockFormat format);
+size_t compressedSize(BlockFormat format, int w, int h);
+
+// compresses each of `images` into the matching `out`, which has room for
+// `compressedSize(format, w, h)` bytes. Rows of blocks of all images are
+// spread over the shared thread pool, so this must not run on a pool task.
+void compressImages(
+    const ImageData* images, int n_images, BlockFormat format, uint8_t** out
+);
+
+// the single block encoders, `rgba` holds the 16 pixels row by row
+void compressBlockBC1(uint8_t rgba[16][4], uint8_t out[8]);
+void compressBlockBC3(uint8_t rgba[16][4], uint8_t out[16]);
+void compressBlockBC4(const uint8_t values[16], uint8_t out[8]);
+void compressBlockBC5(uint8_t rgba[16][4], uint8_t out[16]);
+void compressBlockBC7(uint8_t rgba[16][4], uint8_t out[16]);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef MIPMAP_HEADER_DEFINED
+#define MIPMAP_HEADER_DEFINED
+
+#include "models/model.h"
+#include <stdbool.h>
+
+/*
+* CPU built mip chains. Every level is a 2x2 box filter of the previous one,
+* for srgb images the color channels are averaged in linear space (alpha is
+* always linear), which keeps bright / dark edges from darkening with
+* distance the way averaging the encoded values does.
+*/
+
+#define MAX_MIP_LEVELS 16
+
+typedef struct {
+  int n_levels;
+  // the first level is the base image itself, the rest is owned
+  ImageData levels[MAX_MIP_LEVELS];
+  unsigned char* storage;
+} MipChain;
+
+int mipLevelCount(int w, int h);
+// size of `level` of an image of size `size`
+int mipSize(int size, int level);
+
+// builds all levels down to 1x1 from `base`, which has to outlive the
+// chain. Rows are spread over the shared thread pool, so this must not run
+// on a pool task.
+bool buildMipChain(const ImageData* base, bool srgb, MipChain* chain);
+void freeMipChain(MipChain* chain);
+
+#endif
@@ -1,8 +1,20 @@
 #ifndef TEXTUER_HEADER_DEFINED
 #define TEXTUER_HEADER_DEFINED
 #include "glad/gl.h"
+#include "models/model.h"
+#include "textures/block_compress.h"
+#include <stdbool.h>
+
+// upload images block compressed, see textures/block_compress.h
+#define COMPRESS_TEXTURES true
 
 typedef enum { PNG, JPG } ImageType;
 GLuint loadTexture(const char* fileName, ImageType type);
 
+// uploads `image` to a new 2d texture, block compressed (through the
+// texture cache) when the driver supports the format. 0 on failure.
+GLuint uploadImage(const ImageData* image, TextureUsage usage);
+// whether the driver lists `format` as a compressed texture format
+bool compressedFormatSupported(GLenum format);
+
 #endif
@@ -0,0 +1,58 @@
+#ifndef TEXTURE_CACHE_HEADER_DEFINED
+#define TEXTURE_CACHE_HEADER_DEFINED
+
+#include "asset_cache.h"
+#include "models/model.h"
+#include "textures/block_compress.h"
+#include "textures/mipmap.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+* Block compressed mip chains in the asset cache, keyed by a hash of the
+* decoded pixels, the target format and the color space the mips were
+* filtered in, so the same image is only filtered and compressed once no
+* matter which file or material it comes from.
+*
+* One file per image and settings, see asset_cache.h:
+*   TextureCacheHeader
+*   compressed blocks of every level, largest first, row by row
+*/
+
+#define TEXTURE_CACHE_MAGIC 0x58544342 // "BCTX"
+#define TEXTURE_CACHE_VERSION 2
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  int32_t w;
+  int32_t h;
+  int32_t format; // `BlockFormat`
+  int32_t n_levels;
+  uint64_t size; // of all levels
+} TextureCacheHeader;
+
+typedef struct {
+  int w;
+  int h;
+  BlockFormat format;
+  int n_levels;
+  size_t level_offset[MAX_MIP_LEVELS]; // into `data`
+  size_t level_size[MAX_MIP_LEVELS];
+  size_t size;
+  uint8_t* data;
+} CompressedImage;
+
+// hash of the size, format and pixels of `image`
+AssetKey hashImage(const ImageData* image);
+
+// the full mip chain of `image` compressed to `format`, read from the
+// cache or built and stored on a miss. `srgb` as in `buildMipChain`.
+// Must not run on a pool task, see `compressImages`.
+bool loadCompressedImage(
+    const ImageData* image, BlockFormat format, bool srgb,
+    CompressedImage* out
+);
+void freeCompressedImage(CompressedImage* image);
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef TEXTURE_STREAM_HEADER_DEFINED
+#define TEXTURE_STREAM_HEADER_DEFINED
+
+#include "glad/gl.h"
+#include "models/model.h"
+#include "textures/block_compress.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+* Asynchronous texture uploads through a ring of persistently mapped pixel
+* unpack buffers.
+*
+* A worker thread builds the (compressed) mip chain of every requested
+* image and copies it into the ring in chunks of rows, smallest level
+* first. Once per frame the gl thread turns the staged chunks into
+* glTexSubImage2D calls from the ring, up to a byte budget, and fences
+* them. Ring space is only reused once the fence of its upload passed.
+* Every level that is complete lowers the base level of its texture, so
+* textures show up blurry and sharpen over the next frames.
+*/
+
+// size of the ring, chunks never exceed a quarter of it
+#define STREAM_RING_SIZE (32 << 20)
+#define STREAM_CHUNK_SIZE (1 << 20)
+// bytes uploaded per `pumpTextureStream`
+#define STREAM_FRAME_BUDGET (8 << 20)
+#define STREAM_MAX_CHUNKS 256
+#define STREAM_MAX_FENCES 64
+
+typedef struct StreamTexture StreamTexture;
+struct StreamTexture {
+  GLuint texture;
+  ImageData image; // the pixels have to outlive the upload
+  TextureUsage usage;
+  bool compressed;
+  BlockFormat block_format;
+  int n_levels;
+  StreamTexture* next; // in the request queue, or the done list
+};
+
+// rows of one level, staged in the ring
+typedef struct {
+  StreamTexture* texture;
+  int level;
+  int y;
+  int w;
+  int h;
+  size_t offset;  // in the ring
+  size_t size;
+  size_t release; // ring bytes freed once uploaded, includes padding
+  bool last;      // last chunk of its level
+} StreamChunk;
+
+typedef struct {
+  GLsync fence;
+  size_t release;
+} StreamFence;
+
+typedef struct {
+  GLuint pbo;
+  unsigned char* ring; // persistent, coherent mapping of `pbo`
+  size_t head;         // next write, only moved by the worker
+  size_t used;         // bytes between the oldest fence and `head`
+
+  StreamChunk chunks[STREAM_MAX_CHUNKS]; // staged, fifo
+  int chunk_head;
+  int n_chunks;
+  StreamFence fences[STREAM_MAX_FENCES]; // in flight, fifo, gl thread only
+  int fence_head;
+  int n_fences;
+
+  StreamTexture* requests; // fifo, `requests_tail` is the newest
+  StreamTexture* requests_tail;
+  StreamTexture* done; // staged, freed once no staged chunk refers to them
+  int n_busy;          // requests not fully uploaded yet
+
+  pthread_t worker;
+  pthread_mutex_t lock;
+  pthread_cond_t changed; // requests, ring space or chunk slots
+  bool stop;
+} TextureStream;
+
+// on the gl thread, NULL when persistent buffers are not available
+TextureStream* createTextureStream(void);
+void destroyTextureStream(TextureStream* stream);
+
+// a new texture whose levels are streamed in over the next frames.
+// `image->data` has to stay valid until `textureStreamIdle`.
+GLuint streamImage(
+    TextureStream* stream, const ImageData* image, TextureUsage usage
+);
+// once per frame on the gl thread
+void pumpTextureStream(TextureStream* stream);
+// every request staged and submitted, their pixels and textures may be
+// freed
+bool textureStreamIdle(TextureStream* stream);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef THREAD_POOL_HEADER_DEFINED
+#define THREAD_POOL_HEADER_DEFINED
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/*
+* Fixed size pool of worker threads consuming a FIFO of tasks.
+* Tasks are plain function + argument pairs, results are written by the
+* task itself into memory owned by the submitter, which keeps results
+* deterministic regardless of the order the tasks are executed in.
+*/
+
+typedef void (*TaskFn)(void* arg);
+
+// a set of tasks that can be waited on independently of the rest of the
+// pool. Only touched while holding the pool lock.
+typedef struct {
+  int pending;
+} TaskGroup;
+
+typedef struct {
+  TaskFn fn;
+  void* arg;
+  TaskGroup* group;
+} Task;
+
+typedef struct {
+  pthread_t* threads;
+  int n_threads;
+
+  pthread_mutex_t lock;
+  pthread_cond_t has_work; // signaled when tasks are queued or on shutdown
+  pthread_cond_t idle;     // signaled when the last pending task finishes
+
+  Task* queue; // ring buffer
+  int capacity;
+  int head;
+  int count;
+  int pending; // queued + currently running tasks
+  bool stop;
+} ThreadPool;
+
+// n_threads <= 0 creates one thread per online cpu
+ThreadPool* createThreadPool(int n_threads);
+void destroyThreadPool(ThreadPool* pool);
+
+// `group` is optional. Without a pool the task runs inline.
+// Tasks must not wait on the pool they run on.
+void submitTask(ThreadPool* pool, TaskGroup* group, TaskFn fn, void* arg);
+// blocks until every task submitted so far has finished
+void waitThreadPool(ThreadPool* pool);
+// blocks until every task submitted with `group` has finished
+void waitTaskGroup(ThreadPool* pool, TaskGroup* group);
+
+// process wide pool used by the asset loaders, created on first use
+ThreadPool* sharedThreadPool(void);
+
+#endif
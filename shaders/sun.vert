@@ -4,19 +4,50 @@ layout (location = 0) in vec3 in_vertices;
 layout (location = 1) in vec3 in_normals;
 layout (location = 2) in vec4 in_tangents;
 layout (location = 3) in vec2 in_coordinates;
+// world transform of the instance, see models/scene.h
+layout (location = 4) in mat4 in_instance;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// see models/quantize.h. Integer attributes of the file are normalized by
+// the vertex fetch, and have the identity transform and no octahedrals
+uniform bool oct_normals;
+uniform bool oct_tangents;
+uniform vec3 pos_offset;
+uniform vec3 pos_scale;
+
 out vec3 normals;
 out vec4 tangents;
 out vec2 coordinates;
 // out vec3 gl_Position 
 
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
+// the cofactor matrix, the inverse transpose up to the determinant. Only
+// its sign matters once normalized, mirrored transforms flip it back.
+mat3 normalMatrix(mat3 m) {
+    mat3 c = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+    return dot(m[0], c[0]) < 0.0 ? -c : c;
+}
+
 void main() {
-    normals  = in_normals;
+    vec3 position = pos_offset + in_vertices * pos_scale;
+    normals  = oct_normals ? octDecode(in_normals.xy) : in_normals;
     tangents = in_tangents;
+    if (oct_tangents)
+        tangents = vec4(octDecode(in_tangents.xy), in_tangents.z);
+    // tangents follow the surface, normals need the inverse transpose
+    // once nodes or instances are scaled non uniformly
+    mat4 world  = model * in_instance;
+    normals     = normalize(normalMatrix(mat3(world)) * normals);
+    tangents    = vec4(normalize(mat3(world) * tangents.xyz), tangents.w);
     coordinates = in_coordinates;
-    gl_Position  = projection * view * model * vec4(in_vertices, 1.0);
+    gl_Position  = projection * view * world * vec4(position, 1.0);
 }
@@ -0,0 +1,225 @@
+#define _DEFAULT_SOURCE
+#include "asset_cache.h"
+#include "util.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// MurmurHash3 x64 128 constants
+#define HASH_C1 0x87c37b91114253d5ull
+#define HASH_C2 0x4cf5ad432745937full
+
+static const char* ASSET_EXT[N_ASSET_KINDS] = {".mesh", ".bc", ".prog"};
+static const char* ASSET_NAME[N_ASSET_KINDS] = {"mesh", "texture", "program"};
+
+typedef struct {
+  int hits;
+  int misses;
+  int writes;
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+} AssetStats;
+
+// artifacts are looked up and written from the texture stream as well
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static AssetStats stats[N_ASSET_KINDS];
+static int n_evicted;
+
+static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static uint64_t fmix(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdull;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ull;
+  k ^= k >> 33;
+  return k;
+}
+
+AssetKey hashAsset(const void* data, size_t size, AssetKey seed) {
+  const uint8_t* p = data;
+  uint64_t h1      = seed.lo;
+  uint64_t h2      = seed.hi;
+
+  // sixteen bytes at a time, then the tail
+  size_t n_blocks = size / 16;
+  for (size_t i = 0; i < n_blocks; i++) {
+    uint64_t k1, k2;
+    memcpy(&k1, p + i * 16, 8);
+    memcpy(&k2, p + i * 16 + 8, 8);
+    h1 ^= rotl(k1 * HASH_C1, 31) * HASH_C2;
+    h1 = (rotl(h1, 27) + h2) * 5 + 0x52dce729;
+    h2 ^= rotl(k2 * HASH_C2, 33) * HASH_C1;
+    h2 = (rotl(h2, 31) + h1) * 5 + 0x38495ab5;
+  }
+  uint64_t tail[2] = {0};
+  memcpy(tail, p + n_blocks * 16, size % 16);
+  h1 ^= rotl(tail[0] * HASH_C1, 31) * HASH_C2;
+  h2 ^= rotl(tail[1] * HASH_C2, 33) * HASH_C1;
+
+  h1 ^= size;
+  h2 ^= size;
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix(h1);
+  h2 = fmix(h2);
+  h1 += h2;
+  h2 += h1;
+  return (AssetKey){h1, h2};
+}
+
+bool assetPath(char* path, size_t n, AssetKind kind, AssetKey key) {
+  int len = snprintf(
+      path,
+      n,
+      "%s/%016llx%016llx%s",
+      ASSET_CACHE_DIR,
+      (unsigned long long)key.hi,
+      (unsigned long long)key.lo,
+      ASSET_EXT[kind]
+  );
+  return len > 0 && (size_t)len < n;
+}
+
+void assetHit(AssetKind kind, const char* path, size_t size) {
+  // the modification time doubles as the last use, atime is often off
+  utimensat(AT_FDCWD, path, NULL, 0);
+  pthread_mutex_lock(&cache_lock);
+  stats[kind].hits++;
+  stats[kind].bytes_read += size;
+  pthread_mutex_unlock(&cache_lock);
+}
+
+void assetMiss(AssetKind kind) {
+  pthread_mutex_lock(&cache_lock);
+  stats[kind].misses++;
+  pthread_mutex_unlock(&cache_lock);
+}
+
+typedef struct {
+  char name[256];
+  uint64_t size;
+  struct timespec used;
+} CachedFile;
+
+static int compareUse(const void* a, const void* b) {
+  const struct timespec* x = &((const CachedFile*)a)->used;
+  const struct timespec* y = &((const CachedFile*)b)->used;
+  if (x->tv_sec != y->tv_sec) return x->tv_sec < y->tv_sec ? -1 : 1;
+  if (x->tv_nsec != y->tv_nsec) return x->tv_nsec < y->tv_nsec ? -1 : 1;
+  return 0;
+}
+
+/// the artifacts in the cache directory, temporary files are skipped
+static CachedFile* listCache(int* n, uint64_t* total) {
+  *n     = 0;
+  *total = 0;
+  DIR* dir = opendir(ASSET_CACHE_DIR);
+  if (!dir) return NULL;
+  int cap          = 0;
+  CachedFile* list = NULL;
+  struct dirent* e;
+  while ((e = readdir(dir))) {
+    if (e->d_name[0] == '.' || strstr(e->d_name, ".tmp")) continue;
+    if (strlen(e->d_name) >= sizeof(list->name)) continue;
+    struct stat st;
+    if (fstatat(dirfd(dir), e->d_name, &st, 0) || !S_ISREG(st.st_mode))
+      continue;
+    if (*n == cap) {
+      cap              = cap ? 2 * cap : 64;
+      CachedFile* more = realloc(list, cap * sizeof(CachedFile));
+      if (!more) break;
+      list = more;
+    }
+    CachedFile* f = &list[(*n)++];
+    snprintf(f->name, sizeof(f->name), "%s", e->d_name);
+    f->size = (uint64_t)st.st_size;
+    f->used = st.st_mtim;
+    *total += f->size;
+  }
+  closedir(dir);
+  return list;
+}
+
+/// removes the least recently used artifacts until the cache fits
+static void evictAssets(void) {
+  int n;
+  uint64_t total;
+  CachedFile* list = listCache(&n, &total);
+  if (total > ASSET_CACHE_MAX_SIZE) {
+    qsort(list, n, sizeof(CachedFile), compareUse);
+    char path[512];
+    for (int i = 0; i < n && total > ASSET_CACHE_MAX_SIZE; i++) {
+      snprintf(path, sizeof(path), "%s/%s", ASSET_CACHE_DIR, list[i].name);
+      if (unlink(path)) continue;
+      total -= list[i].size;
+      n_evicted++;
+    }
+  }
+  free(list);
+}
+
+FILE* beginAsset(const char* path, char* tmp_path, size_t n) {
+  if (mkdir(ASSET_CACHE_DIR, 0755) && errno != EEXIST) return NULL;
+  // unique, two threads may build the same artifact at once
+  int len = snprintf(tmp_path, n, "%s.tmp.XXXXXX", path);
+  if (len < 0 || (size_t)len >= n) return NULL;
+  int fd = mkstemp(tmp_path);
+  if (fd < 0) return NULL;
+  FILE* f = fdopen(fd, "wb");
+  if (!f) {
+    close(fd);
+    remove(tmp_path);
+  }
+  return f;
+}
+
+bool endAsset(
+    AssetKind kind, FILE* f, const char* tmp_path, const char* path, bool ok
+) {
+  long size = ftell(f);
+  ok        = (fclose(f) == 0) && ok;
+  if (!ok || rename(tmp_path, path)) {
+    remove(tmp_path);
+    return false;
+  }
+  pthread_mutex_lock(&cache_lock);
+  stats[kind].writes++;
+  stats[kind].bytes_written += size > 0 ? (uint64_t)size : 0;
+  evictAssets();
+  pthread_mutex_unlock(&cache_lock);
+  return true;
+}
+
+void printAssetCacheStats(void) {
+  pthread_mutex_lock(&cache_lock);
+  int n;
+  uint64_t total;
+  free(listCache(&n, &total));
+  printf("> asset cache %s\n", ASSET_CACHE_DIR);
+  printf(
+      ">   %d files, %.1f of %.1f MiB\n",
+      n,
+      total / 1048576.0,
+      ASSET_CACHE_MAX_SIZE / 1048576.0
+  );
+  FOR(k, N_ASSET_KINDS) {
+    AssetStats* s = &stats[k];
+    printf(
+        ">   %-8s %d hits (%.1f MiB read), %d misses, %d writes (%.1f MiB)\n",
+        ASSET_NAME[k],
+        s->hits,
+        s->bytes_read / 1048576.0,
+        s->misses,
+        s->writes,
+        s->bytes_written / 1048576.0
+    );
+  }
+  printf(">   %d evicted\n", n_evicted);
+  pthread_mutex_unlock(&cache_lock);
+}
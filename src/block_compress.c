@@ -0,0 +1,444 @@
+#include "textures/block_compress.h"
+#include "thread_pool.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// part of EXT_texture_compression_s3tc, which glad was not generated with
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// BC3 encodes faster, BC7 keeps more detail in color and alpha
+#define RGBA_BLOCK_FORMAT BLOCK_BC7
+// rows of blocks compressed by one task
+#define BAND_ROWS 8
+#define POWER_ITERATIONS 8
+
+BlockFormat blockFormatFor(ImageFormat format, TextureUsage usage) {
+  if (usage == TEXTURE_NORMAL) return BLOCK_BC5;
+  switch (format) {
+  case GRAY_ALPHA:
+  case RED_GEEN_BLUE_ALPHA: return RGBA_BLOCK_FORMAT;
+  default: return BLOCK_BC1;
+  }
+}
+
+int block_format_to_gl_const(BlockFormat format) {
+  switch (format) {
+  case BLOCK_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  case BLOCK_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  case BLOCK_BC5: return GL_COMPRESSED_RG_RGTC2;
+  case BLOCK_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+  default: return -1;
+  }
+}
+
+int blockSize(BlockFormat format) { return format == BLOCK_BC1 ? 8 : 16; }
+
+size_t compressedSize(BlockFormat format, int w, int h) {
+  return (size_t)((w + 3) / 4) * ((h + 3) / 4) * blockSize(format);
+}
+
+// === endpoint fitting ===
+
+static inline float clampByte(float v) {
+  return v < 0.0f ? 0.0f : v > 255.0f ? 255.0f : v;
+}
+
+/// mean and direction of largest variance of the first `n_ch` channels
+static void principalAxis(
+    float px[16][4], int n_ch, float mean[4], float axis[4]
+) {
+  float cov[4][4] = {0};
+  FOR(k, 4) mean[k] = 0.0f;
+  FOR(i, 16) FOR(k, n_ch) mean[k] += px[i][k] * (1.0f / 16.0f);
+  FOR(i, 16) FOR(j, n_ch) FOR(k, n_ch) {
+    cov[j][k] += (px[i][j] - mean[j]) * (px[i][k] - mean[k]);
+  }
+
+  // power iteration, starting from the channel with the largest variance
+  int start = 0;
+  FOR(k, n_ch) if (cov[k][k] > cov[start][start]) start = k;
+  FOR(k, 4) axis[k] = k == start ? 1.0f : 0.0f;
+  FOR(it, POWER_ITERATIONS) {
+    float next[4] = {0};
+    float len     = 0.0f;
+    FOR(j, n_ch) FOR(k, n_ch) next[j] += cov[j][k] * axis[k];
+    FOR(k, n_ch) len += next[k] * next[k];
+    if (len == 0.0f) return; // flat block, the axis does not matter
+    len = 1.0f / sqrtf(len);
+    FOR(k, n_ch) axis[k] = next[k] * len;
+  }
+}
+
+/// the extremes of the block projected onto its principal axis
+static void fitEndpoints(
+    float px[16][4], int n_ch, float e0[4], float e1[4]
+) {
+  float mean[4], axis[4];
+  principalAxis(px, n_ch, mean, axis);
+  float t_min = INFINITY, t_max = -INFINITY;
+  FOR(i, 16) {
+    float t = 0.0f;
+    FOR(k, n_ch) t += (px[i][k] - mean[k]) * axis[k];
+    t_min = t < t_min ? t : t_min;
+    t_max = t > t_max ? t : t_max;
+  }
+  FOR(k, 4) {
+    e0[k] = clampByte(mean[k] + axis[k] * t_min);
+    e1[k] = clampByte(mean[k] + axis[k] * t_max);
+  }
+}
+
+/// least squares endpoints for pixels at fixed positions `t` between them,
+/// false when the positions do not determine both endpoints
+static bool refineEndpoints(
+    float px[16][4], int n_ch, const float t[16], float e0[4],
+    float e1[4]
+) {
+  float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+  float ax[4] = {0}, bx[4] = {0};
+  FOR(i, 16) {
+    float a = 1.0f - t[i], b = t[i];
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    FOR(k, n_ch) {
+      ax[k] += a * px[i][k];
+      bx[k] += b * px[i][k];
+    }
+  }
+  float det = aa * bb - ab * ab;
+  if (fabsf(det) < 1e-6f) return false;
+  det = 1.0f / det;
+  FOR(k, n_ch) {
+    e0[k] = clampByte((bb * ax[k] - ab * bx[k]) * det);
+    e1[k] = clampByte((aa * bx[k] - ab * ax[k]) * det);
+  }
+  return true;
+}
+
+/// index of the closest palette entry for every pixel, returns the error
+static float pickIndices(
+    float px[16][4], int n_ch, float pal[][4], int n_pal,
+    uint8_t idx[16]
+) {
+  float error = 0.0f;
+  FOR(i, 16) {
+    float best = INFINITY;
+    FOR(p, n_pal) {
+      float d = 0.0f;
+      FOR(k, n_ch) d += (px[i][k] - pal[p][k]) * (px[i][k] - pal[p][k]);
+      if (d < best) {
+        best   = d;
+        idx[i] = p;
+      }
+    }
+    error += best;
+  }
+  return error;
+}
+
+static void toFloats(uint8_t rgba[16][4], float px[16][4]) {
+  FOR(i, 16) FOR(k, 4) px[i][k] = rgba[i][k];
+}
+
+// === BC1 ===
+
+static uint16_t to565(const float c[4]) {
+  return (uint16_t)(lrintf(c[0] * (31.0f / 255.0f)) << 11 |
+                    lrintf(c[1] * (63.0f / 255.0f)) << 5 |
+                    lrintf(c[2] * (31.0f / 255.0f)));
+}
+
+static void from565(uint16_t v, float c[4]) {
+  int r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+  c[0]  = (r << 3) | (r >> 2);
+  c[1]  = (g << 2) | (g >> 4);
+  c[2]  = (b << 3) | (b >> 2);
+  c[3]  = 255.0f;
+}
+
+// position of each index between the first and the second endpoint
+static const float BC1_T[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+/// 4 color mode palette and indices, the endpoints are ordered c0 > c1
+static float encodeBC1(
+    float px[16][4], uint16_t* c0, uint16_t* c1, uint8_t idx[16]
+) {
+  if (*c0 < *c1) {
+    uint16_t tmp = *c0;
+    *c0          = *c1;
+    *c1          = tmp;
+  }
+  float pal[4][4];
+  from565(*c0, pal[0]);
+  from565(*c1, pal[1]);
+  FOR(k, 3) {
+    pal[2][k] = (2.0f * pal[0][k] + pal[1][k]) / 3.0f;
+    pal[3][k] = (pal[0][k] + 2.0f * pal[1][k]) / 3.0f;
+  }
+  // equal endpoints decode in 3 color mode, where only index 0 is safe
+  return pickIndices(px, 3, pal, *c0 == *c1 ? 1 : 4, idx);
+}
+
+void compressBlockBC1(uint8_t rgba[16][4], uint8_t out[8]) {
+  float px[16][4], e0[4], e1[4];
+  toFloats(rgba, px);
+  fitEndpoints(px, 3, e0, e1);
+
+  uint16_t c0 = to565(e0), c1 = to565(e1);
+  uint8_t idx[16];
+  float error = encodeBC1(px, &c0, &c1, idx);
+
+  // one least squares pass over the chosen indices
+  float t[16];
+  FOR(i, 16) t[i] = BC1_T[idx[i]];
+  if (error > 0.0f && refineEndpoints(px, 3, t, e0, e1)) {
+    uint16_t r0 = to565(e0), r1 = to565(e1);
+    uint8_t r_idx[16];
+    float r_error = encodeBC1(px, &r0, &r1, r_idx);
+    if (r_error < error) {
+      c0 = r0;
+      c1 = r1;
+      memcpy(idx, r_idx, sizeof(idx));
+    }
+  }
+
+  uint32_t bits = 0;
+  FOR(i, 16) bits |= (uint32_t)idx[i] << (i * 2);
+  out[0] = c0 & 0xff;
+  out[1] = c0 >> 8;
+  out[2] = c1 & 0xff;
+  out[3] = c1 >> 8;
+  FOR(k, 4) out[4 + k] = (bits >> (k * 8)) & 0xff;
+}
+
+// === BC4 ===
+
+void compressBlockBC4(const uint8_t values[16], uint8_t out[8]) {
+  // 8 value mode, the first endpoint is the larger one
+  int hi = 0, lo = 255;
+  FOR(i, 16) {
+    hi = values[i] > hi ? values[i] : hi;
+    lo = values[i] < lo ? values[i] : lo;
+  }
+  float pal[8][4] = {{hi}, {lo}};
+  for (int p = 1; p < 7; p++)
+    pal[p + 1][0] = ((7 - p) * hi + p * lo) / 7.0f;
+
+  float px[16][4];
+  uint8_t idx[16];
+  FOR(i, 16) px[i][0] = values[i];
+  pickIndices(px, 1, pal, hi == lo ? 1 : 8, idx);
+
+  uint64_t bits = 0;
+  FOR(i, 16) bits |= (uint64_t)idx[i] << (i * 3);
+  out[0] = hi;
+  out[1] = lo;
+  FOR(k, 6) out[2 + k] = (bits >> (k * 8)) & 0xff;
+}
+
+// === BC3 / BC5 ===
+
+void compressBlockBC3(uint8_t rgba[16][4], uint8_t out[16]) {
+  uint8_t alpha[16];
+  FOR(i, 16) alpha[i] = rgba[i][3];
+  compressBlockBC4(alpha, out);
+  // the color block of BC3 is always decoded in 4 color mode
+  compressBlockBC1(rgba, out + 8);
+}
+
+void compressBlockBC5(uint8_t rgba[16][4], uint8_t out[16]) {
+  uint8_t red[16], green[16];
+  FOR(i, 16) {
+    red[i]   = rgba[i][0];
+    green[i] = rgba[i][1];
+  }
+  compressBlockBC4(red, out);
+  compressBlockBC4(green, out + 8);
+}
+
+// === BC7 ===
+
+static const int BC7_WEIGHTS[16] = {
+    0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64
+};
+
+/// 7 bit endpoint and the shared lowest bit closest to `e`
+static void quantizeBC7(const float e[4], int q[4], int* p_bit) {
+  float best = INFINITY;
+  FOR(p, 2) {
+    int cand[4];
+    float error = 0.0f;
+    FOR(k, 4) {
+      long v  = lrintf((e[k] - p) * 0.5f);
+      cand[k] = v < 0 ? 0 : v > 127 ? 127 : (int)v;
+      float d = (float)(cand[k] * 2 + p) - e[k];
+      error += d * d;
+    }
+    if (error < best) {
+      best   = error;
+      *p_bit = p;
+      memcpy(q, cand, sizeof(cand));
+    }
+  }
+}
+
+/// mode 6 palette and indices for quantized endpoints
+static float encodeBC7(
+    float px[16][4], int q[2][4], const int p_bit[2],
+    uint8_t idx[16]
+) {
+  float pal[16][4];
+  FOR(w, 16) FOR(k, 4) {
+    int e0     = q[0][k] * 2 + p_bit[0];
+    int e1     = q[1][k] * 2 + p_bit[1];
+    int weight = BC7_WEIGHTS[w];
+    pal[w][k]  = ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+  }
+  return pickIndices(px, 4, pal, 16, idx);
+}
+
+typedef struct {
+  uint8_t* out;
+  int pos;
+} BitWriter;
+
+static void writeBits(BitWriter* w, uint32_t v, int n) {
+  for (int i = 0; i < n; i++, w->pos++)
+    if ((v >> i) & 1) w->out[w->pos >> 3] |= 1 << (w->pos & 7);
+}
+
+void compressBlockBC7(uint8_t rgba[16][4], uint8_t out[16]) {
+  float px[16][4], e[2][4];
+  toFloats(rgba, px);
+  fitEndpoints(px, 4, e[0], e[1]);
+
+  int q[2][4], p_bit[2];
+  uint8_t idx[16];
+  FOR(j, 2) quantizeBC7(e[j], q[j], &p_bit[j]);
+  float error = encodeBC7(px, q, p_bit, idx);
+
+  // one least squares pass over the chosen indices
+  float t[16];
+  FOR(i, 16) t[i] = BC7_WEIGHTS[idx[i]] / 64.0f;
+  if (error > 0.0f && refineEndpoints(px, 4, t, e[0], e[1])) {
+    int r_q[2][4], r_p_bit[2];
+    uint8_t r_idx[16];
+    FOR(j, 2) quantizeBC7(e[j], r_q[j], &r_p_bit[j]);
+    float r_error = encodeBC7(px, r_q, r_p_bit, r_idx);
+    if (r_error < error) {
+      memcpy(q, r_q, sizeof(q));
+      memcpy(p_bit, r_p_bit, sizeof(p_bit));
+      memcpy(idx, r_idx, sizeof(idx));
+    }
+  }
+
+  // the highest index bit of the first pixel is implicitly 0
+  if (idx[0] & 8) {
+    FOR(k, 4) {
+      int tmp = q[0][k];
+      q[0][k] = q[1][k];
+      q[1][k] = tmp;
+    }
+    int tmp  = p_bit[0];
+    p_bit[0] = p_bit[1];
+    p_bit[1] = tmp;
+    FOR(i, 16) idx[i] = 15 - idx[i];
+  }
+
+  memset(out, 0, 16);
+  BitWriter w = {out, 0};
+  writeBits(&w, 1 << 6, 7); // mode 6
+  FOR(k, 4) FOR(j, 2) writeBits(&w, q[j][k], 7);
+  FOR(j, 2) writeBits(&w, p_bit[j], 1);
+  FOR(i, 16) writeBits(&w, idx[i], i == 0 ? 3 : 4);
+}
+
+// === images ===
+
+typedef struct {
+  const ImageData* image;
+  BlockFormat format;
+  uint8_t* out;
+  int first_row;
+  int n_rows;
+} BandTask;
+
+/// the 4x4 block at `bx`, `by` as rgba, edges are clamped
+static void loadBlock(
+    const ImageData* image, int bx, int by, uint8_t rgba[16][4]
+) {
+  int n_ch = image->format + 1;
+  FOR(i, 16) {
+    int x = bx * 4 + i % 4, y = by * 4 + i / 4;
+    x     = x < image->w ? x : image->w - 1;
+    y     = y < image->h ? y : image->h - 1;
+    const uint8_t* p = &image->data[((size_t)y * image->w + x) * n_ch];
+    bool gray        = image->format == GRAY || image->format == GRAY_ALPHA;
+    bool alpha       = image->format == GRAY_ALPHA || n_ch == 4;
+    FOR(k, 3) rgba[i][k] = gray ? p[0] : p[k];
+    rgba[i][3] = alpha ? p[n_ch - 1] : 255;
+  }
+}
+
+static void compressBandTask(void* arg) {
+  BandTask* task         = arg;
+  const ImageData* image = task->image;
+  int blocks_x           = (image->w + 3) / 4;
+  int size               = blockSize(task->format);
+  uint8_t rgba[16][4];
+  for (int by = task->first_row; by < task->first_row + task->n_rows; by++) {
+    FOR(bx, blocks_x) {
+      uint8_t* out = &task->out[((size_t)by * blocks_x + bx) * size];
+      loadBlock(image, bx, by, rgba);
+      switch (task->format) {
+      case BLOCK_BC1: compressBlockBC1(rgba, out); break;
+      case BLOCK_BC3: compressBlockBC3(rgba, out); break;
+      case BLOCK_BC5: compressBlockBC5(rgba, out); break;
+      default: compressBlockBC7(rgba, out); break;
+      }
+    }
+  }
+}
+
+void compressImages(
+    const ImageData* images, int n_images, BlockFormat format, uint8_t** out
+) {
+  int n_tasks = 0;
+  FOR(i, n_images) {
+    int blocks_y = (images[i].h + 3) / 4;
+    n_tasks += (blocks_y + BAND_ROWS - 1) / BAND_ROWS;
+  }
+  BandTask* tasks = malloc(n_tasks * sizeof(BandTask));
+
+  // without memory for the tasks every image runs as one inline band
+  if (!tasks) {
+    FOR(i, n_images) {
+      BandTask task = {&images[i], format, out[i], 0, (images[i].h + 3) / 4};
+      compressBandTask(&task);
+    }
+    return;
+  }
+
+  // small images (the tail of a mip chain) share the pool with large ones
+  ThreadPool* pool = sharedThreadPool();
+  TaskGroup group  = {0};
+  int n            = 0;
+  FOR(i, n_images) {
+    int blocks_y = (images[i].h + 3) / 4;
+    for (int first = 0; first < blocks_y; first += BAND_ROWS, n++) {
+      int rows = blocks_y - first < BAND_ROWS ? blocks_y - first : BAND_ROWS;
+      tasks[n] = (BandTask){&images[i], format, out[i], first, rows};
+      submitTask(pool, &group, compressBandTask, &tasks[n]);
+    }
+  }
+  waitTaskGroup(pool, &group);
+  free(tasks);
+}
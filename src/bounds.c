@@ -0,0 +1,100 @@
+#include "models/bounds.h"
+#include "simd.h"
+#include <float.h>
+#include <math.h>
+
+void boundingBox(const float* p, int n, float min[3], float max[3]) {
+  for (int c = 0; c < 3; c++) {
+    min[c] = n ? FLT_MAX : 0.0f;
+    max[c] = n ? -FLT_MAX : 0.0f;
+  }
+  int i = 0;
+#if defined(__SSE2__)
+  __m128 lo[3], hi[3];
+  for (int c = 0; c < 3; c++) {
+    lo[c] = _mm_set1_ps(FLT_MAX);
+    hi[c] = _mm_set1_ps(-FLT_MAX);
+  }
+  for (; i + 4 <= n; i += 4) {
+    __m128 v[3];
+    load3x4(&p[i * 3], &v[0], &v[1], &v[2]);
+    for (int c = 0; c < 3; c++) {
+      lo[c] = _mm_min_ps(lo[c], v[c]);
+      hi[c] = _mm_max_ps(hi[c], v[c]);
+    }
+  }
+  for (int c = 0; c < 3; c++) {
+    float l[4], h[4];
+    _mm_storeu_ps(l, lo[c]);
+    _mm_storeu_ps(h, hi[c]);
+    for (int k = 0; k < 4; k++) {
+      min[c] = fminf(min[c], l[k]);
+      max[c] = fmaxf(max[c], h[k]);
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    for (int c = 0; c < 3; c++) {
+      min[c] = fminf(min[c], p[i * 3 + c]);
+      max[c] = fmaxf(max[c], p[i * 3 + c]);
+    }
+  }
+}
+
+/// the largest squared distance of `n` packed vec3 from `center`
+static float maxDistance2(const float* p, int n, const float center[3]) {
+  float d2 = 0.0f;
+  int i    = 0;
+#if defined(__SSE2__)
+  __m128 far = _mm_setzero_ps();
+  __m128 c[3];
+  for (int k = 0; k < 3; k++) c[k] = _mm_set1_ps(center[k]);
+  for (; i + 4 <= n; i += 4) {
+    __m128 v[3];
+    load3x4(&p[i * 3], &v[0], &v[1], &v[2]);
+    __m128 sum = _mm_setzero_ps();
+    for (int k = 0; k < 3; k++) {
+      __m128 d = _mm_sub_ps(v[k], c[k]);
+      sum      = _mm_add_ps(sum, _mm_mul_ps(d, d));
+    }
+    far = _mm_max_ps(far, sum);
+  }
+  float f[4];
+  _mm_storeu_ps(f, far);
+  for (int k = 0; k < 4; k++) d2 = fmaxf(d2, f[k]);
+#endif
+  for (; i < n; i++) {
+    float sum = 0.0f;
+    for (int k = 0; k < 3; k++) {
+      float d = p[i * 3 + k] - center[k];
+      sum += d * d;
+    }
+    d2 = fmaxf(d2, sum);
+  }
+  return d2;
+}
+
+/// sets the box and its center, returns the squared half diagonal
+static float setBox(MeshBounds* b, const float min[3], const float max[3]) {
+  float d2 = 0.0f;
+  for (int c = 0; c < 3; c++) {
+    b->min[c]    = min[c];
+    b->max[c]    = max[c];
+    b->center[c] = 0.5f * (min[c] + max[c]);
+    float h      = 0.5f * (max[c] - min[c]);
+    d2 += h * h;
+  }
+  return d2;
+}
+
+void computeMeshBounds(Mesh* m) {
+  float min[3], max[3];
+  int n = m->vertices ? m->n_vertices : 0;
+  boundingBox(m->vertices, n, min, max);
+  setBox(&m->bounds, min, max);
+  m->bounds.radius = sqrtf(maxDistance2(m->vertices, n, m->bounds.center));
+}
+
+void meshBoundsFromBox(Mesh* m, const float min[3], const float max[3]) {
+  m->bounds.radius = sqrtf(setBox(&m->bounds, min, max));
+}
@@ -0,0 +1,121 @@
+#define _DEFAULT_SOURCE
+#include "file_watch.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// a finished write in place, or a file renamed over the watched one
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO)
+
+static void fileChanged(FileWatcher* watcher, int wd, const char* name) {
+  pthread_mutex_lock(&watcher->lock);
+  for (int i = 0; i < watcher->n_files; i++) {
+    WatchedFile* f = &watcher->files[i];
+    if (f->wd != wd || strcmp(f->name, name)) continue;
+    bool queued = false;
+    for (int j = 0; j < watcher->n_changed; j++)
+      queued |= watcher->changed[j] == f->id;
+    if (!queued) watcher->changed[watcher->n_changed++] = f->id;
+  }
+  pthread_mutex_unlock(&watcher->lock);
+}
+
+static void* watchThread(void* arg) {
+  FileWatcher* watcher = arg;
+  _Alignas(struct inotify_event) char buffer[4096];
+  struct pollfd fds[2] = {
+      {.fd = watcher->fd, .events = POLLIN},
+      {.fd = watcher->wake[0], .events = POLLIN},
+  };
+  for (;;) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    if (fds[1].revents) break;
+
+    ssize_t len = read(watcher->fd, buffer, sizeof(buffer));
+    if (len <= 0) continue;
+    const struct inotify_event* e;
+    for (char* p = buffer; p < buffer + len; p += sizeof(*e) + e->len) {
+      e = (const struct inotify_event*)p;
+      if (e->len) fileChanged(watcher, e->wd, e->name);
+    }
+  }
+  return NULL;
+}
+
+FileWatcher* createFileWatcher(void) {
+  FileWatcher* watcher = calloc(1, sizeof(FileWatcher));
+  if (!watcher) return NULL;
+  watcher->fd = inotify_init1(IN_CLOEXEC);
+  if (watcher->fd < 0) goto fail;
+  if (pipe(watcher->wake)) goto fail_fd;
+
+  pthread_mutex_init(&watcher->lock, NULL);
+  if (pthread_create(&watcher->thread, NULL, watchThread, watcher)) {
+    pthread_mutex_destroy(&watcher->lock);
+    close(watcher->wake[0]);
+    close(watcher->wake[1]);
+    goto fail_fd;
+  }
+  return watcher;
+
+fail_fd:
+  close(watcher->fd);
+fail:
+  free(watcher);
+  return NULL;
+}
+
+void destroyFileWatcher(FileWatcher* watcher) {
+  char stop = 0;
+  if (write(watcher->wake[1], &stop, 1) == 1)
+    pthread_join(watcher->thread, NULL);
+  else pthread_detach(watcher->thread);
+  close(watcher->wake[0]);
+  close(watcher->wake[1]);
+  close(watcher->fd);
+  pthread_mutex_destroy(&watcher->lock);
+  free(watcher);
+}
+
+bool watchFile(FileWatcher* watcher, const char* path, int id) {
+  // split into the directory to watch and the name to match
+  char dir[1024];
+  const char* slash = strrchr(path, '/');
+  const char* name  = slash ? slash + 1 : path;
+  int dir_len       = slash ? (int)(slash - path) : 0;
+  if (dir_len >= (int)sizeof(dir) || strlen(name) >= MAX_FILE_NAME)
+    return false;
+  if (slash) snprintf(dir, sizeof(dir), "%.*s", dir_len ? dir_len : 1, path);
+  else snprintf(dir, sizeof(dir), ".");
+
+  // watching a directory twice returns the same descriptor
+  int wd = inotify_add_watch(watcher->fd, dir, WATCH_MASK | IN_MASK_ADD);
+  if (wd < 0) return false;
+
+  pthread_mutex_lock(&watcher->lock);
+  bool ok = watcher->n_files < MAX_WATCHED_FILES;
+  if (ok) {
+    WatchedFile* f = &watcher->files[watcher->n_files++];
+    f->wd          = wd;
+    f->id          = id;
+    snprintf(f->name, sizeof(f->name), "%s", name);
+  }
+  pthread_mutex_unlock(&watcher->lock);
+  return ok;
+}
+
+int pollFileChanges(FileWatcher* watcher, int* ids) {
+  pthread_mutex_lock(&watcher->lock);
+  int n = watcher->n_changed;
+  memcpy(ids, watcher->changed, n * sizeof(int));
+  watcher->n_changed = 0;
+  pthread_mutex_unlock(&watcher->lock);
+  return n;
+}
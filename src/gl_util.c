@@ -1,74 +1,314 @@
-
 #include "gl_util.h"
+#include "models/quantize.h"
 #include <stdlib.h>
+#include <string.h>
 
 #define bindArrayBuffer(vbo) glBindBuffer(GL_ARRAY_BUFFER, (vbo))
 #define arrayBufferData(size, ptr)                                             \
   glBufferData(GL_ARRAY_BUFFER, size, ptr, GL_STATIC_DRAW)
 
-void genGlIds(GlIdentifier* wrappers, int n) {
-  // I. We create all VAOs, VBOs, and EBO
+// how each attribute is stored in a `Mesh`
+static const VertexAttribFormat MESH_ATTRIBS[N_BUFFER_TYPES] = {
+    [VERTEX]   = {true, 3, GL_FLOAT, GL_FALSE, 0, 0},
+    [NORMAL]   = {true, 3, GL_FLOAT, GL_FALSE, 0, 0},
+    [TANGENT]  = {true, 4, GL_FLOAT, GL_FALSE, 0, 0},
+    [TEXCOORD] = {true, 2, GL_FLOAT, GL_FALSE, 0, 0},
+};
+
+// how each attribute is stored in a `QuantizedMesh`
+static const VertexAttribFormat QUANTIZED_ATTRIBS[N_BUFFER_TYPES] = {
+    [VERTEX]   = {true, 4, GL_UNSIGNED_SHORT, GL_TRUE, 0, 0},
+    [NORMAL]   = {true, 2, GL_SHORT, GL_TRUE, 0, 0},
+    [TANGENT]  = {true, 4, GL_SHORT, GL_TRUE, 0, 0},
+    [TEXCOORD] = {true, 2, GL_HALF_FLOAT, GL_FALSE, 0, 0},
+};
+
+static GLuint typeSize(GLenum type) {
+  switch (type) {
+  case GL_BYTE:
+  case GL_UNSIGNED_BYTE: return 1;
+  case GL_SHORT:
+  case GL_UNSIGNED_SHORT:
+  case GL_HALF_FLOAT: return 2;
+  default: return 4;
+  }
+}
+
+static GLuint attribSize(const VertexAttribFormat* a) {
+  return a->size * typeSize(a->type);
+}
+
+// every attribute starts 4 byte aligned
+static GLuint paddedSize(const VertexAttribFormat* a) {
+  return (attribSize(a) + 3) & ~3;
+}
+
+/// attributes quantized in the file are uploaded the way they are stored
+static bool keepsFileFormat(const Mesh* m, BUFFER_TYPE type) {
+  return m->formats[type].type != COMPONENT_F32;
+}
+
+static VertexAttribFormat
+attribFormat(const Mesh* m, BUFFER_TYPE type, bool quantized) {
+  if (!keepsFileFormat(m, type))
+    return quantized ? QUANTIZED_ATTRIBS[type] : MESH_ATTRIBS[type];
+  VertexAttribFormat a = MESH_ATTRIBS[type];
+  a.type               = component_type_to_gl_const(m->formats[type].type);
+  a.normalized         = m->formats[type].normalized;
+  return a;
+}
+
+VertexFormat
+meshVertexFormat(const Mesh* m, VertexLayout layout, bool quantized) {
+  VertexFormat f = {.layout = layout, .quantized = quantized};
+  // largest attributes first
+  static const BUFFER_TYPE order[N_BUFFER_TYPES] = {
+      VERTEX, TANGENT, NORMAL, TEXCOORD
+  };
+  for (int k = 0; k < N_BUFFER_TYPES; k++) {
+    BUFFER_TYPE t         = order[k];
+    VertexAttribFormat* a = &f.attribs[t];
+    *a                    = attribFormat(m, t, quantized);
+    a->enabled            = meshAttribute(m, t) != NULL;
+    if (!a->enabled) continue;
+
+    if (layout == LAYOUT_SEPARATE) a->binding = t;
+    else a->binding = t == VERTEX ? 0 : 1;
+    a->offset = f.stride[a->binding];
+    // which keeps every vertex 4 byte aligned as well
+    f.stride[a->binding] += paddedSize(a);
+  }
+  f.n_bindings = layout == LAYOUT_SEPARATE ? N_BUFFER_TYPES : 2;
+  return f;
+}
+
+/// packs every attribute that uses `binding` into one buffer
+static void* interleave(
+    const VertexFormat* f, const void* const data[], int n, GLuint binding
+) {
+  size_t stride = f->stride[binding];
+  char* buffer  = calloc(n, stride);
+  if (!buffer) return NULL;
+  for (int t = 0; t < N_BUFFER_TYPES; t++) {
+    const VertexAttribFormat* a = &f->attribs[t];
+    if (!a->enabled || a->binding != binding) continue;
+    const char* src = data[t];
+    size_t size     = attribSize(a);
+    size_t step     = paddedSize(a);
+    char* dst       = buffer + a->offset;
+    for (int v = 0; v < n; v++, src += step, dst += stride)
+      memcpy(dst, src, size);
+  }
+  return buffer;
+}
+
+void genGlIds(
+    GlIdentifier* wrappers, int n, VertexLayout layout, bool quantize
+) {
+  // We create all VAOs, VBOs, and EBO. The vertex format is set up once
+  // we know which attributes each mesh has, in `syncBuffers`
   GLuint* VAO     = malloc(n * sizeof(GLuint));
   VBOBuffers* VBO = malloc(n * sizeof(VBOBuffers));
   GLuint* EBO     = malloc(n * sizeof(GLuint));
+  GLuint* IBO     = malloc(n * sizeof(GLuint));
   glGenVertexArrays(n, VAO);
   glGenBuffers(n * N_BUFFER_TYPES, (GLuint*)VBO);
   glGenBuffers(n, EBO);
-  wrappers->vao = VAO;
-  wrappers->vbo = VBO;
-  wrappers->ebo = EBO;
-
-  // II. then we bind them to each other
-  for (int i = 0; i < n; i++) {
-    glBindVertexArray(VAO[i]);
-    GLuint* buffers = (GLuint*)&VBO[i];
-    // bind vertex, normal, tangend texcoord buffers
-    for (int j = 0; j < N_BUFFER_TYPES; j++) {
-      glBindBuffer(GL_ARRAY_BUFFER, buffers[j]);
-      glVertexAttribPointer(
-          j,                 // id
-          COMPONENT_SIZE[j], // number of floats per component
-          GL_FLOAT,
-          GL_FALSE,
-          COMPONENT_SIZE[j] * sizeof(float), // stride
-          (void*)0                           // offset
-      );
-    }
-    // and bind index buffer
-    glBindBuffer(GL_ARRAY_BUFFER, EBO[i]);
-  }
+  glGenBuffers(n, IBO);
+  glGenBuffers(1, &wrappers->instances);
+  wrappers->vao       = VAO;
+  wrappers->vbo       = VBO;
+  wrappers->ebo       = EBO;
+  wrappers->indirect  = IBO;
+  wrappers->dequant   = calloc(n, sizeof(VertexDequant));
+  wrappers->layout    = layout;
+  wrappers->quantized = quantize;
 }
+
+static int lodTriangles(const Mesh* m, int lod) {
+  return lod ? m->lods[lod - 1].n_triangles : m->n_triangles;
+}
+
+/// byte offset of the indices of `lod` in the index buffer
+static GLintptr lodOffset(const Mesh* m, int lod) {
+  GLintptr offset = 0;
+  FOR(l, lod) offset += (GLintptr)lodTriangles(m, l) * 3;
+  return offset * indexSize(m->index_type);
+}
+
 // copy mesh contents to vram
 void syncBuffers(Mesh* meshes, GlIdentifier* ids, int n_meshes) {
   for (int i = 0; i < n_meshes; i++) {
     GLuint vao   = ids->vao[i];
-    GLuint* vbos = (GLuint*)&ids->vbo[i]; // struct is packed
+    GLuint* vbos = ids->vbo[i].buffers;
     GLuint ebo   = ids->ebo[i];
 
-    Mesh m           = meshes[i];
-    float* buffer[4] = {m.vertices, m.normals, m.tangents, m.tex_coords};
-    int n            = m.n_vertices;
+    Mesh* m        = &meshes[i];
+    VertexFormat f = meshVertexFormat(m, ids->layout, ids->quantized);
+    int n          = m->n_vertices;
+
+    // the source of each attribute. Attributes quantized in the file are
+    // uploaded as the mesh stores them, the float ones go through the
+    // compact encoding when quantizing. Only the latter have float arrays,
+    // so `quantizeMesh` skips the others.
+    QuantizedMesh q       = {0};
+    VertexDequant dequant = {.pos_scale = {1, 1, 1}};
+    const void* data[N_BUFFER_TYPES];
+    for (int t = 0; t < N_BUFFER_TYPES; t++) data[t] = meshAttribute(m, t);
+    if (ids->quantized) {
+      quantizeMesh(m, &q);
+      if (m->vertices) {
+        memcpy(dequant.pos_offset, q.pos_offset, sizeof(q.pos_offset));
+        memcpy(dequant.pos_scale, q.pos_scale, sizeof(q.pos_scale));
+      }
+      dequant.oct_normals  = m->normals != NULL;
+      dequant.oct_tangents = m->tangents != NULL;
+      const void* compact[N_BUFFER_TYPES] = {
+          q.positions, q.normals, q.tangents, q.tex_coords
+      };
+      for (int t = 0; t < N_BUFFER_TYPES; t++)
+        if (data[t] && !keepsFileFormat(m, t)) data[t] = compact[t];
+    }
+    if (ids->dequant) ids->dequant[i] = dequant;
 
     glBindVertexArray(vao);
-    for (int j = 0; j < N_BUFFER_TYPES; j++) {
-      if (buffer[i]) {
-        glBindBuffer(GL_ARRAY_BUFFER, vbos[j]);
-        glBufferData(
-            GL_ARRAY_BUFFER,
-            n * COMPONENT_SIZE[i] * sizeof(float),
-            buffer[i],
-            GL_STATIC_DRAW
-        );
+
+    // I. upload the vertex data, one buffer per binding
+    for (int b = 0; b < f.n_bindings; b++) {
+      if (!f.stride[b]) continue;
+      bindArrayBuffer(vbos[b]);
+      if (f.layout == LAYOUT_SEPARATE) {
+        arrayBufferData(n * f.stride[b], data[b]);
+      } else {
+        void* buffer = interleave(&f, data, n, b);
+        arrayBufferData(n * f.stride[b], buffer);
+        free(buffer);
       }
     }
-    if (m.indices) {
+
+    // II. and describe to the VAO where each attribute is found
+    for (int t = 0; t < N_BUFFER_TYPES; t++) {
+      const VertexAttribFormat* a = &f.attribs[t];
+      if (!a->enabled) {
+        glDisableVertexAttribArray(t);
+        continue;
+      }
+      glVertexAttribFormat(t, a->size, a->type, a->normalized, a->offset);
+      glVertexAttribBinding(t, a->binding);
+      glEnableVertexAttribArray(t);
+    }
+    for (int b = 0; b < f.n_bindings; b++)
+      if (f.stride[b]) glBindVertexBuffer(b, vbos[b], 0, f.stride[b]);
+
+    // the instance transforms, one column per location
+    FOR(c, 4) {
+      GLuint loc = INSTANCE_LOCATION + c;
+      glVertexAttribFormat(loc, 4, GL_FLOAT, GL_FALSE, c * 4 * sizeof(float));
+      glVertexAttribBinding(loc, INSTANCE_BINDING);
+      glEnableVertexAttribArray(loc);
+    }
+    glBindVertexBuffer(
+        INSTANCE_BINDING, ids->instances, 0, 16 * sizeof(float)
+    );
+    glVertexBindingDivisor(INSTANCE_BINDING, 1);
+
+    // III. the indices of every level of detail, one after the other
+    if (m->indices) {
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
       glBufferData(
           GL_ELEMENT_ARRAY_BUFFER,
-          m.n_triangles * 3 * sizeof(float),
-          m.indices,
+          lodOffset(m, m->n_lods + 1),
+          NULL,
           GL_STATIC_DRAW
       );
+      for (int l = 0; l <= m->n_lods; l++) {
+        const void* indices = l ? m->lods[l - 1].indices : m->indices;
+        GLintptr offset     = lodOffset(m, l);
+        GLsizeiptr size     = lodOffset(m, l + 1) - offset;
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, size, indices);
+      }
     }
+    freeQuantizedMesh(&q);
   }
+  glBindVertexArray(0);
+}
+
+void syncInstances(GlIdentifier* ids, const float* matrices, int n) {
+  // rewritten every frame, orphan the previous transforms
+  bindArrayBuffer(ids->instances);
+  glBufferData(
+      GL_ARRAY_BUFFER, n * 16 * sizeof(float), matrices, GL_STREAM_DRAW
+  );
+}
+
+void drawMesh(const Mesh* m, GlIdentifier* ids, int i) {
+  drawMeshLod(m, ids, i, 0, (InstanceRange){0, 1});
+}
+
+void drawMeshLod(
+    const Mesh* m, GlIdentifier* ids, int i, int lod, InstanceRange instances
+) {
+  if (instances.count == 0) return;
+  glBindVertexArray(ids->vao[i]);
+  if (!m->indices) {
+    glDrawArraysInstancedBaseInstance(
+        GL_TRIANGLES, 0, m->n_vertices, instances.count, instances.first
+    );
+    return;
+  }
+  if (lod > m->n_lods) lod = m->n_lods;
+  glDrawElementsInstancedBaseInstance(
+      GL_TRIANGLES,
+      lodTriangles(m, lod) * 3,
+      index_type_to_gl_const(m->index_type),
+      (const void*)lodOffset(m, lod),
+      instances.count,
+      instances.first
+  );
+}
+
+void drawMeshlets(
+    const Mesh* m, GlIdentifier* ids, int i, InstanceRange instances,
+    const MeshletRange* ranges, int n_ranges
+) {
+  if (!m->indices || n_ranges == 0 || instances.count == 0) return;
+  // the commands are rebuilt every frame, orphan the previous ones
+  GLsizeiptr size = n_ranges * sizeof(DrawElementsIndirectCommand);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ids->indirect[i]);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, size, NULL, GL_STREAM_DRAW);
+  DrawElementsIndirectCommand* cmds = glMapBufferRange(
+      GL_DRAW_INDIRECT_BUFFER,
+      0,
+      size,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+  );
+  if (!cmds) return;
+  FOR(r, n_ranges) {
+    cmds[r] = (DrawElementsIndirectCommand){
+        .count          = ranges[r].n_triangles * 3,
+        .instance_count = instances.count,
+        .first_index    = ranges[r].first_triangle * 3,
+        .base_instance  = instances.first,
+    };
+  }
+  glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
+
+  glBindVertexArray(ids->vao[i]);
+  glMultiDrawElementsIndirect(
+      GL_TRIANGLES, index_type_to_gl_const(m->index_type), 0, n_ranges, 0
+  );
+}
+
+void freeGlIds(GlIdentifier* ids, int n) {
+  glDeleteVertexArrays(n, ids->vao);
+  glDeleteBuffers(n * N_BUFFER_TYPES, (GLuint*)ids->vbo);
+  glDeleteBuffers(n, ids->ebo);
+  glDeleteBuffers(n, ids->indirect);
+  glDeleteBuffers(1, &ids->instances);
+  free(ids->vao);
+  free(ids->vbo);
+  free(ids->ebo);
+  free(ids->indirect);
+  free(ids->dequant);
+  *ids = (GlIdentifier){0};
 }
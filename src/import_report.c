@@ -0,0 +1,117 @@
+#define _DEFAULT_SOURCE
+#include "models/import_report.h"
+#include "util.h"
+#include <time.h>
+
+static const char* PHASE_NAME[N_IMPORT_PHASES] = {
+    "cache_load",
+    "parse",
+    "validate",
+    "buffers",
+    "decompress",
+    "scene",
+    "images",
+    "attributes",
+    "indices",
+    "frames",
+    "optimize",
+    "cache_write",
+};
+
+static const char* DATA_NAME[N_IMPORT_DATA] = {
+    "positions",
+    "normals",
+    "tangents",
+    "tex_coords",
+    "indices",
+    "images",
+};
+
+static double seconds(clockid_t id) {
+  struct timespec t;
+  clock_gettime(id, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+ClockReading readClock(void) {
+  return (ClockReading){
+      seconds(CLOCK_MONOTONIC), seconds(CLOCK_THREAD_CPUTIME_ID)
+  };
+}
+
+void addPhaseTime(PhaseTime* phase, ClockReading begin, ClockReading end) {
+  // a task that never ran was never timed
+  if (begin.wall == 0.0) return;
+  if (phase->begin == 0.0 || begin.wall < phase->begin)
+    phase->begin = begin.wall;
+  if (end.wall > phase->end) phase->end = end.wall;
+  phase->cpu += end.cpu - begin.cpu;
+}
+
+ClockReading endPhase(
+    ImportReport* report, ImportPhase phase, ClockReading begin
+) {
+  ClockReading now = readClock();
+  addPhaseTime(&report->phases[phase], begin, now);
+  return now;
+}
+
+/// `s` as a json string
+static void writeString(const char* s, FILE* f) {
+  fputc('"', f);
+  for (; s && *s; s++) {
+    unsigned char c = *s;
+    if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+    else if (c < 0x20) fprintf(f, "\\u%04x", c);
+    else fputc(c, f);
+  }
+  fputc('"', f);
+}
+
+static void writeTime(const char* name, const PhaseTime* t, FILE* f) {
+  fprintf(
+      f,
+      "\"%s\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f}",
+      name,
+      (t->end - t->begin) * 1e3,
+      t->cpu * 1e3
+  );
+}
+
+void writeImportReport(const ImportReport* report, FILE* f) {
+  fputs("{\"path\":", f);
+  writeString(report->path, f);
+  fprintf(
+      f,
+      ",\"success\":%s,\"cached\":%s,\"meshes\":%d,\"nodes\":%d,"
+      "\"images\":%d,",
+      report->success ? "true" : "false",
+      report->cached ? "true" : "false",
+      report->n_meshes,
+      report->n_nodes,
+      report->n_images
+  );
+  writeTime("total", &report->total, f);
+
+  fputs(",\"phases\":{", f);
+  int n = 0;
+  FOR(p, N_IMPORT_PHASES) {
+    const PhaseTime* t = &report->phases[p];
+    if (t->begin == 0.0) continue;
+    if (n++) fputc(',', f);
+    writeTime(PHASE_NAME[p], t, f);
+  }
+  fputs("},\"bytes\":{", f);
+  FOR(d, N_IMPORT_DATA) {
+    fprintf(
+        f,
+        "%s\"%s\":%llu",
+        d ? "," : "",
+        DATA_NAME[d],
+        (unsigned long long)report->bytes[d]
+    );
+  }
+  fputs("}}\n", f);
+  // one complete line per import, even when the process is killed later
+  fflush(f);
+}
@@ -0,0 +1,356 @@
+#include "models/lod.h"
+#include "models/mesh_optimize.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// collapses are only taken up to this factor of the cost of the collapse
+// that would reach the target, such that one pass does not take expensive
+// collapses while cheap ones become available in the next
+#define PASS_ERROR_SLACK 1.5f
+#define MAX_PASSES 64
+
+/// symmetric 4x4 matrix of plane equations, scaled by triangle area
+typedef struct {
+  double a00, a01, a02, a03;
+  double a11, a12, a13;
+  double a22, a23;
+  double a33;
+  double w; // total area
+} Quadric;
+
+typedef struct {
+  float cost;
+  uint32_t from;
+  uint32_t to;
+} Collapse;
+
+static void addQuadric(Quadric* q, const Quadric* r) {
+  q->a00 += r->a00, q->a01 += r->a01, q->a02 += r->a02, q->a03 += r->a03;
+  q->a11 += r->a11, q->a12 += r->a12, q->a13 += r->a13;
+  q->a22 += r->a22, q->a23 += r->a23;
+  q->a33 += r->a33;
+  q->w += r->w;
+}
+
+static Quadric planeQuadric(const float* p0, const float* p1, const float* p2) {
+  double e1[3], e2[3];
+  FOR(k, 3) {
+    e1[k] = p1[k] - p0[k];
+    e2[k] = p2[k] - p0[k];
+  }
+  double n[3] = {
+      e1[1] * e2[2] - e1[2] * e2[1],
+      e1[2] * e2[0] - e1[0] * e2[2],
+      e1[0] * e2[1] - e1[1] * e2[0],
+  };
+  double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+  if (len == 0.0) return (Quadric){0};
+  FOR(k, 3) n[k] /= len;
+  double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+  double w = len * 0.5;
+  return (Quadric){
+      w * n[0] * n[0], w * n[0] * n[1], w * n[0] * n[2], w * n[0] * d,
+      w * n[1] * n[1], w * n[1] * n[2], w * n[1] * d,
+      w * n[2] * n[2], w * n[2] * d,
+      w * d * d,
+      w,
+  };
+}
+
+/// mean squared distance of `p` to the planes of `q`
+static float quadricError(const Quadric* q, const float* p) {
+  if (q->w <= 0.0) return 0.0f;
+  double x = p[0], y = p[1], z = p[2];
+  double e = q->a00 * x * x + q->a11 * y * y + q->a22 * z * z + q->a33 +
+             2.0 * (q->a01 * x * y + q->a02 * x * z + q->a12 * y * z +
+                    q->a03 * x + q->a13 * y + q->a23 * z);
+  e /= q->w;
+  return e > 0.0 ? (float)e : 0.0f;
+}
+
+static int compareCollapses(const void* a, const void* b) {
+  float ca = ((const Collapse*)a)->cost;
+  float cb = ((const Collapse*)b)->cost;
+  return (ca > cb) - (ca < cb);
+}
+
+static int compareEdges(const void* a, const void* b) {
+  uint64_t ea = *(const uint64_t*)a;
+  uint64_t eb = *(const uint64_t*)b;
+  return (ea > eb) - (ea < eb);
+}
+
+/// maps every vertex onto the first vertex with the same position, such
+/// that uv / normal seams do not look like holes in the mesh
+static void positionRemap(const float* positions, int n, uint32_t* remap) {
+  size_t size = 1;
+  while (size < (size_t)n * 2) size <<= 1;
+  uint32_t* table = malloc(size * sizeof(uint32_t));
+  if (!table) {
+    FOR(v, n) remap[v] = v;
+    return;
+  }
+  memset(table, 0xff, size * sizeof(uint32_t));
+  FOR(v, n) {
+    uint32_t bits[3];
+    memcpy(bits, &positions[v * 3], sizeof(bits));
+    size_t h = (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^
+               (bits[2] * 83492791u);
+    for (h &= size - 1;; h = (h + 1) & (size - 1)) {
+      uint32_t other = table[h];
+      if (other == UINT32_MAX) {
+        table[h] = remap[v] = v;
+        break;
+      }
+      if (!memcmp(&positions[other * 3], &positions[v * 3], sizeof(bits))) {
+        remap[v] = other;
+        break;
+      }
+    }
+  }
+  free(table);
+}
+
+/// marks vertices on seams and open borders, they keep their position
+static void lockVertices(
+    const uint32_t* remap, int n_vertices, const uint32_t* indices,
+    int n_indices, bool* locked
+) {
+  FOR(v, n_vertices) locked[v] = false;
+  FOR(v, n_vertices) if (remap[v] != (uint32_t)v) locked[v] = true;
+  FOR(v, n_vertices) if (locked[v]) locked[remap[v]] = true;
+
+  // an edge used by one triangle only is on a border
+  uint64_t* edges = malloc(n_indices * sizeof(uint64_t));
+  if (!edges) {
+    // nothing can be classified, so nothing may move
+    FOR(v, n_vertices) locked[v] = true;
+    return;
+  }
+  FOR(i, n_indices) {
+    uint64_t a = remap[indices[i]];
+    uint64_t b = remap[indices[i - i % 3 + (i + 1) % 3]];
+    edges[i]   = a < b ? a << 32 | b : b << 32 | a;
+  }
+  qsort(edges, n_indices, sizeof(uint64_t), compareEdges);
+  for (int i = 0, j; i < n_indices; i = j) {
+    for (j = i + 1; j < n_indices && edges[j] == edges[i]; j++);
+    if (j - i != 1) continue;
+    locked[edges[i] >> 32]        = true;
+    locked[edges[i] & UINT32_MAX] = true;
+  }
+  free(edges);
+  // the wedges of a locked position are locked as well
+  FOR(v, n_vertices) locked[v] = locked[v] || locked[remap[v]];
+}
+
+/// would moving `from` onto `to` flip or collapse one of its triangles
+static bool flipsTriangle(
+    const float* positions, const uint32_t* remap, const uint32_t* indices,
+    const int* adjacency, int n_adjacent, uint32_t from, uint32_t to
+) {
+  const float* target = &positions[to * 3];
+  FOR(a, n_adjacent) {
+    const uint32_t* tri = &indices[adjacency[a] * 3];
+    int k               = 0;
+    while (tri[k] != from) k++;
+    uint32_t b = tri[(k + 1) % 3], c = tri[(k + 2) % 3];
+    // the triangles on the collapsed edge disappear
+    if (remap[b] == remap[to] || remap[c] == remap[to]) continue;
+
+    const float* p0 = &positions[from * 3];
+    const float* p1 = &positions[b * 3];
+    const float* p2 = &positions[c * 3];
+    float e1[3], e2[3], f1[3], f2[3];
+    FOR(j, 3) {
+      e1[j] = p1[j] - p0[j], e2[j] = p2[j] - p0[j];
+      f1[j] = p1[j] - target[j], f2[j] = p2[j] - target[j];
+    }
+    float n0[3] = {
+        e1[1] * e2[2] - e1[2] * e2[1],
+        e1[2] * e2[0] - e1[0] * e2[2],
+        e1[0] * e2[1] - e1[1] * e2[0],
+    };
+    float n1[3] = {
+        f1[1] * f2[2] - f1[2] * f2[1],
+        f1[2] * f2[0] - f1[0] * f2[2],
+        f1[0] * f2[1] - f1[1] * f2[0],
+    };
+    if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0f) return true;
+  }
+  return false;
+}
+
+int simplifyMesh(
+    const float* positions, int n_vertices, const uint32_t* indices,
+    int n_indices, int target, uint32_t* out, float* error
+) {
+  *error = 0.0f;
+  memcpy(out, indices, n_indices * sizeof(uint32_t));
+
+  uint32_t* remap      = malloc(n_vertices * sizeof(uint32_t));
+  bool* locked         = malloc(n_vertices * sizeof(bool));
+  bool* touched        = malloc(n_vertices * sizeof(bool));
+  uint32_t* collapse   = malloc(n_vertices * sizeof(uint32_t));
+  Quadric* quadrics    = calloc(n_vertices, sizeof(Quadric));
+  int* offsets         = malloc((n_vertices + 1) * sizeof(int));
+  int* adjacency       = malloc(n_indices * sizeof(int));
+  Collapse* candidates = malloc(n_indices * sizeof(Collapse));
+  if (!remap || !locked || !touched || !collapse || !quadrics || !offsets ||
+      !adjacency || !candidates)
+    goto clean;
+
+  positionRemap(positions, n_vertices, remap);
+  lockVertices(remap, n_vertices, indices, n_indices, locked);
+
+  // quadrics are kept per position, shared by all its wedges
+  for (int i = 0; i < n_indices; i += 3) {
+    const uint32_t* tri = &indices[i];
+    Quadric q           = planeQuadric(
+        &positions[tri[0] * 3], &positions[tri[1] * 3], &positions[tri[2] * 3]
+    );
+    FOR(k, 3) addQuadric(&quadrics[remap[tri[k]]], &q);
+  }
+
+  for (int pass = 0; pass < MAX_PASSES && n_indices > target; pass++) {
+    // I. triangles around every vertex
+    memset(offsets, 0, (n_vertices + 1) * sizeof(int));
+    FOR(i, n_indices) offsets[out[i] + 1]++;
+    FOR(v, n_vertices) offsets[v + 1] += offsets[v];
+    FOR(i, n_indices) adjacency[offsets[out[i]]++] = i / 3;
+    for (int v = n_vertices; v > 0; v--) offsets[v] = offsets[v - 1];
+    offsets[0] = 0;
+
+    // II. every half edge starting at a free vertex is a candidate
+    int n_candidates = 0;
+    FOR(i, n_indices) {
+      uint32_t from = out[i];
+      uint32_t to   = out[i - i % 3 + (i + 1) % 3];
+      if (locked[from] || remap[from] == remap[to]) continue;
+      Quadric q = quadrics[remap[from]];
+      addQuadric(&q, &quadrics[remap[to]]);
+      candidates[n_candidates++] =
+          (Collapse){quadricError(&q, &positions[to * 3]), from, to};
+    }
+    if (n_candidates == 0) break;
+    qsort(candidates, n_candidates, sizeof(Collapse), compareCollapses);
+
+    // III. take the cheapest collapses that do not interfere, every
+    // collapse removes about two triangles
+    int goal = (n_indices - target) / 6;
+    if (goal < 1) goal = 1;
+    float limit = candidates[goal < n_candidates ? goal : n_candidates - 1]
+                      .cost *
+                  PASS_ERROR_SLACK;
+    FOR(v, n_vertices) {
+      touched[v]  = false;
+      collapse[v] = v;
+    }
+    int n_collapses = 0;
+    FOR(c, n_candidates) {
+      Collapse e = candidates[c];
+      if (n_collapses >= goal || e.cost > limit) break;
+      if (touched[e.from] || touched[remap[e.to]]) continue;
+      const int* adj = &adjacency[offsets[e.from]];
+      int n_adj      = offsets[e.from + 1] - offsets[e.from];
+      if (flipsTriangle(positions, remap, out, adj, n_adj, e.from, e.to))
+        continue;
+
+      // the one ring of `from` changes shape, keep it fixed for this pass
+      FOR(a, n_adj) FOR(k, 3) {
+        uint32_t v        = out[adj[a] * 3 + k];
+        touched[v]        = true;
+        touched[remap[v]] = true;
+      }
+      collapse[e.from] = e.to;
+      addQuadric(&quadrics[remap[e.to]], &quadrics[remap[e.from]]);
+      if (e.cost > *error) *error = e.cost;
+      n_collapses++;
+    }
+    if (n_collapses == 0) break;
+
+    // IV. apply the collapses and drop the degenerate triangles
+    int n = 0;
+    for (int i = 0; i < n_indices; i += 3) {
+      uint32_t a = collapse[out[i]];
+      uint32_t b = collapse[out[i + 1]];
+      uint32_t c = collapse[out[i + 2]];
+      if (remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a])
+        continue;
+      out[n++] = a, out[n++] = b, out[n++] = c;
+    }
+    n_indices = n;
+  }
+  // quadric errors are squared distances
+  *error = sqrtf(*error);
+
+clean:
+  free(remap);
+  free(locked);
+  free(touched);
+  free(collapse);
+  free(quadrics);
+  free(offsets);
+  free(adjacency);
+  free(candidates);
+  return n_indices;
+}
+
+void generateMeshLods(Mesh* m, Arena* arena) {
+  m->n_lods = 0;
+  if (!m->indices || !m->vertices) return;
+
+  int n         = m->n_triangles * 3;
+  uint32_t* src = widenIndices(m);
+  uint32_t* dst = malloc(n * sizeof(uint32_t));
+  if (!src || !dst) goto clean;
+
+  // every level is simplified from the previous one, so their errors add up
+  float error = 0.0f;
+  while (m->n_lods < MAX_MESH_LODS) {
+    int target = n / 6 * 3;
+    if (target / 3 < LOD_MIN_TRIANGLES) break;
+    float e;
+    int count =
+        simplifyMesh(m->vertices, m->n_vertices, src, n, target, dst, &e);
+    if (count > n * LOD_MIN_REDUCTION) break;
+    optimizeVertexCache(dst, count, m->n_vertices);
+
+    MeshLod* lod = &m->lods[m->n_lods];
+    lod->indices = arenaAllocAligned(
+        arena, count * indexSize(m->index_type), MODEL_ALIGNMENT
+    );
+    copyIndices(lod->indices, m->index_type, dst, INDEX_U32, count);
+    error += e;
+    lod->n_triangles = count / 3;
+    lod->error       = error;
+    m->n_lods++;
+
+    uint32_t* tmp = src;
+    src           = dst;
+    dst           = tmp;
+    n             = count;
+  }
+
+clean:
+  free(src);
+  free(dst);
+}
+
+float lodErrorScale(float fov_y, int viewport_height) {
+  return viewport_height / (2.0f * tanf(fov_y * 0.5f));
+}
+
+int selectMeshLod(
+    const Mesh* m, float distance, float error_scale, float max_pixels
+) {
+  if (distance < 1e-4f) distance = 1e-4f;
+  int level = 0;
+  FOR(l, m->n_lods) {
+    if (m->lods[l].error * error_scale / distance > max_pixels) break;
+    level = l + 1;
+  }
+  return level;
+}
@@ -2,16 +2,26 @@
 #include "glad/gl.h"
 #include "GLFW/glfw3.h"
 #include <cglm/cglm.h>
+#include <float.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 // local dependencies
 #include "init.h"
 #include "shaders/shader.h"
 #include "external/stb_image.h"
 #include "textures/texture.h"
+#include "textures/texture_stream.h"
 #include "models/model.h"
+#include "models/mesh_cache.h"
+#include "models/lod.h"
+#include "models/meshlet.h"
 #include "gl_util.h"
 #include "game_state.h"
+#include "file_watch.h"
+#include "asset_cache.h"
+#include "registry.h"
 
 int H    = 480;
 int W    = 640;
@@ -29,17 +39,92 @@ void onResizeScreen(GLFWwindow* _, int w, int h) {
   H = h;
 }
 
+// a model with everything the gpu needs to draw it, the gpu resources
+// are shared with other models through the registry
 typedef struct {
-  GlIdentifier ids;
-  GLuint shader;
-  GLuint texture;
+  Model model;
+  ResourceHandle* meshes; // one per mesh of the model
+  ResourceHandle texture;
+  SceneInstances instances; // the nodes, grouped into one draw per mesh
+  MeshletRange* visible;    // of the culled mesh, rebuilt every frame
 } RenderModel;
 
 // === application code ===
 
+// how vertex attributes are laid out in vram, see gl_util.h
+#define VERTEX_LAYOUT LAYOUT_INTERLEAVED
+#define QUANTIZE_VERTICES true
+// largest on screen deviation from the full mesh, in pixels
+#define LOD_MAX_PIXEL_ERROR 1.0f
+// only submit the meshlets that pass frustum and backface culling
+#define CULL_MESHLETS true
+
 // shader paths
 const char* SUN_VERT_SRC = "shaders/sun.vert";
 const char* SUN_FRAG_SRC = "shaders/sun.frag";
+const char* MODEL_PATH   = "models/earth.glb";
+
+// what a changed file reloads
+enum { RELOAD_SHADER, RELOAD_MODEL };
+
+// the texture levels stream in over the next frames when `stream` is set,
+// the model (and with it the pixels) has to outlive them. The import is
+// reported as json to `report` when it is set.
+bool loadRenderModel(
+    const char* path, Registry* registry, TextureStream* stream,
+    FILE* report, RenderModel* r
+) {
+  *r                  = (RenderModel){0};
+  ImportReport import = {0};
+  LoadModelRes res    = loadModel(path, &r->model, &import);
+  if (report) writeImportReport(&import, report);
+  if (res != SUCCESS) return false;
+  if (!r->model.n_meshes || !r->model.n_materials) {
+    freeModel(&r->model);
+    return false;
+  }
+  r->meshes = calloc(r->model.n_meshes, sizeof(ResourceHandle));
+  if (!r->meshes ||
+      !buildSceneInstances(&r->model.scene, r->model.n_meshes, &r->instances)) {
+    free(r->meshes);
+    freeModel(&r->model);
+    return false;
+  }
+  int max_meshlets = 0;
+  FOR(mi, r->model.n_meshes) {
+    Mesh* mesh = &r->model.meshes[mi];
+    r->meshes[mi] =
+        acquireMesh(registry, mesh, VERTEX_LAYOUT, QUANTIZE_VERTICES);
+    if (mesh->n_meshlets > max_meshlets) max_meshlets = mesh->n_meshlets;
+  }
+  r->visible = malloc(max_meshlets * sizeof(MeshletRange));
+
+  ImageData* image = &r->model.materials[0].textures[BASE].image;
+  r->texture = acquireTexture(registry, image, TEXTURE_COLOR, stream);
+  return true;
+}
+
+void freeRenderModel(Registry* registry, RenderModel* r) {
+  releaseResource(registry, r->texture);
+  FOR(mi, r->model.n_meshes) releaseResource(registry, r->meshes[mi]);
+  free(r->meshes);
+  freeSceneInstances(&r->instances);
+  free(r->visible);
+  freeModel(&r->model);
+  *r = (RenderModel){0};
+}
+
+// a new program from the shader sources, the old one stays on failure
+void reloadShader(GLuint* shader, ShaderVars* vars) {
+  GLuint reloaded = loadShader(SUN_VERT_SRC, SUN_FRAG_SRC);
+  if (!reloaded) {
+    printf("> could not reload shader, keeping the old one\n");
+    return;
+  }
+  glDeleteProgram(*shader);
+  *shader = reloaded;
+  *vars   = loadShaderVars(reloaded);
+}
 
 #define closeWindow() glfwSetWindowShouldClose(w, true);
 #define K(key) GLFW_KEY_##key
@@ -86,29 +171,23 @@ void mouseCallback(GLFWwindow* w, double cx, double cy) {
   glm_vec3_normalize(s->camera.right);
 }
 
-#define N_MODELS 2
-
-float vertices[] = {
-    -0.5f, -0.5f, -0.5f, 0.5f,  -0.5f, -0.5f, 0.5f,  0.5f,  -0.5f,
-    0.5f,  0.5f,  -0.5f, -0.5f, 0.5f,  -0.5f, -0.5f, -0.5f, -0.5f,
-
-    -0.5f, -0.5f, 0.5f,  0.5f,  -0.5f, 0.5f,  0.5f,  0.5f,  0.5f,
-    0.5f,  0.5f,  0.5f,  -0.5f, 0.5f,  0.5f,  -0.5f, -0.5f, 0.5f,
-
-    -0.5f, 0.5f,  0.5f,  -0.5f, 0.5f,  -0.5f, -0.5f, -0.5f, -0.5f,
-    -0.5f, -0.5f, -0.5f, -0.5f, -0.5f, 0.5f,  -0.5f, 0.5f,  0.5f,
-
-    0.5f,  0.5f,  0.5f,  0.5f,  0.5f,  -0.5f, 0.5f,  -0.5f, -0.5f,
-    0.5f,  -0.5f, -0.5f, 0.5f,  -0.5f, 0.5f,  0.5f,  0.5f,  0.5f,
-
-    -0.5f, -0.5f, -0.5f, 0.5f,  -0.5f, -0.5f, 0.5f,  -0.5f, 0.5f,
-    0.5f,  -0.5f, 0.5f,  -0.5f, -0.5f, 0.5f,  -0.5f, -0.5f, -0.5f,
-
-    -0.5f, 0.5f,  -0.5f, 0.5f,  0.5f,  -0.5f, 0.5f,  0.5f,  0.5f,
-    0.5f,  0.5f,  0.5f,  -0.5f, 0.5f,  0.5f,  -0.5f, 0.5f,  -0.5f,
-};
+int main(int argc, char** argv) {
+  // === command line ===
+  // --cache-stats: report the asset cache on exit
+  // --import-report[=<file>]: write every model import as a line of json
+  // to stderr or <file>, stdout carries the log
+  bool cache_stats = false;
+  FILE* report     = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--cache-stats")) cache_stats = true;
+    else if (!strcmp(argv[i], "--import-report")) report = stderr;
+    else if (!strncmp(argv[i], "--import-report=", 16)) {
+      if (report && report != stderr) fclose(report);
+      if (!(report = fopen(argv[i] + 16, "w")))
+        printf("could not open %s\n", argv[i] + 16);
+    } else printf("unknown argument %s\n", argv[i]);
+  }
 
-int main(void) {
   // === Init glfw and gl context ===
   GLFWwindow* w = initAndCreateWindow(W, H, WT);
   if (!w) goto clean;
@@ -121,11 +200,13 @@ int main(void) {
   glfwSetCursorPosCallback(w, mouseCallback);
 
   // === load 3d models ===
-  Model model          = {0};
-  int model_load_error = loadModelFromGltfFile("models/earth.glb", &model);
-  if (model_load_error) {
+  // the texture streams in over the first frames
+  TextureStream* stream = createTextureStream();
+  Registry registry     = {0};
+  RenderModel render    = {0};
+  if (!loadRenderModel(MODEL_PATH, &registry, stream, report, &render)) {
     printf("could not load model, exiting\n");
-    goto clean;
+    goto unload;
   }
 
   // printf("n vertices: %d\n", model.meshes[0].n_vertices);
@@ -138,11 +219,6 @@ int main(void) {
   //   printf("index: %d, vertex: [%f,%f,%f]\n", index, x, y, z);
   // }
 
-  // === generate VAOs, VBOs etc... ===
-  // GlIdentifier ids = {0};
-  // genGlIds(&ids, model.n_meshes);
-  // syncBuffers(model.meshes, &ids, model.n_meshes);
-
   // // === load textures ===
   // GLuint texture =
   //     loadTexture("container2.png", PNG); // TODO load texture form gltf file
@@ -155,12 +231,13 @@ int main(void) {
   GLuint shader = loadShader(SUN_VERT_SRC, SUN_FRAG_SRC);
   if (!shader) {
     printf("could not load shader, exiting\n");
-    goto clean;
+    goto unload;
   }
   ShaderVars vars = loadShaderVars(shader);
   if (vars.model == -1 || vars.view == -1 || vars.projection == -1) {
     printf("could not load uniform variables\n");
-    goto clean;
+    glDeleteProgram(shader);
+    goto unload;
   }
 
   // === mvp setup begin ===
@@ -171,63 +248,15 @@ int main(void) {
   // === game state setup begin ===
   GameState state = defaultGameState(W, H);
 
-  unsigned int VAO, VBO[N_BUFFER_TYPES], EBO;
-  unsigned int texture;
-  glGenVertexArrays(1, &VAO);
-  glGenBuffers(N_BUFFER_TYPES, VBO);
-  glGenBuffers(1, &EBO);
-  glGenTextures(1, &texture);
-
-  // bind object ids
-  glBindVertexArray(VAO);
-  // vertex
-  glBindBuffer(GL_ARRAY_BUFFER, VBO[VERTEX]);
-  glBufferData(
-      GL_ARRAY_BUFFER,
-      model.meshes[0].n_vertices * 3 * sizeof(float),
-      model.meshes[0].vertices,
-      GL_STATIC_DRAW
-  );
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-  // texcoord
-  glBindBuffer(GL_ARRAY_BUFFER, VBO[TEXCOORD]);
-  glBufferData(
-      GL_ARRAY_BUFFER,
-      model.meshes[0].n_vertices * 2 * sizeof(float),
-      model.meshes[0].tex_coords,
-      GL_STATIC_DRAW
-  );
-  glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(3);
-  //indices
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(
-      GL_ELEMENT_ARRAY_BUFFER,
-      model.meshes[0].n_triangles * 3 * sizeof(unsigned int),
-      model.meshes[0].indices,
-      GL_STATIC_DRAW
-  );
-  ImageData* image = &model.materials[0].textures[BASE].image;
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(
-      GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR
-  );
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glBindTexture(GL_TEXTURE_2D, texture);
-  glTexImage2D(
-      GL_TEXTURE_2D,
-      0,
-      GL_RGB,
-      image->w,
-      image->h,
-      0,
-      GL_RGB,
-      GL_UNSIGNED_BYTE,
-      image->data
-  );
-  glGenerateMipmap(GL_TEXTURE_2D);
+  // === hot reload ===
+  // edited files are picked up between frames
+  FileWatcher* watcher = createFileWatcher();
+  if (watcher) {
+    watchFile(watcher, SUN_VERT_SRC, RELOAD_SHADER);
+    watchFile(watcher, SUN_FRAG_SRC, RELOAD_SHADER);
+    watchFile(watcher, MODEL_PATH, RELOAD_MODEL);
+  }
+  bool model_changed = false;
 
   GLenum err;
   while ((err = glGetError()) != GL_NO_ERROR) {
@@ -241,33 +270,135 @@ int main(void) {
   // === Application loop ==
   // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
   while (!glfwWindowShouldClose(w)) {
+    // === reload ===
+    int changed[MAX_WATCHED_FILES];
+    int n_changed = watcher ? pollFileChanges(watcher, changed) : 0;
+    FOR(i, n_changed) {
+      if (changed[i] == RELOAD_SHADER) reloadShader(&shader, &vars);
+      if (changed[i] == RELOAD_MODEL) model_changed = true;
+    }
+    // the old texture and pixels may only go once the stream is done
+    // with them
+    if (model_changed && (!stream || textureStreamIdle(stream))) {
+      model_changed = false;
+      RenderModel reloaded;
+      // loaded before the old model goes, so whatever did not change is
+      // kept on the gpu
+      if (loadRenderModel(
+              MODEL_PATH, &registry, stream, report, &reloaded
+          )) {
+        freeRenderModel(&registry, &render);
+        render = reloaded;
+      } else {
+        printf("> could not reload model, keeping the old one\n");
+      }
+    }
+
     // === update ===
     float time = glfwGetTime();
     updateFrameTime(&state.frame_t, time); // update frame time
     handleInput(w, &state);                // handle input
     cameraLookAt(&state.camera, v);        // update v
-    glm_perspective(glm_rad(45.0), (float)W / (float)H, 0.1, 100.0, p);
+    float fov = glm_rad(45.0);
+    glm_perspective(fov, (float)W / (float)H, 0.1, 100.0, p);
+
+    // the nodes may move, their transforms are gathered every frame
+    SceneInstances* instances = &render.instances;
+    updateSceneTransforms(&render.model.scene);
+    updateSceneInstances(&render.model.scene, instances);
+
+    if (stream) pumpTextureStream(stream);
 
     // === draw ===
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glBindVertexArray(VAO);
     glUseProgram(shader);
+    glBindTexture(GL_TEXTURE_2D, resourceTexture(&registry, render.texture));
 
     glUniformMatrix4fv(vars.model, 1, false, (float*)m);
     glUniformMatrix4fv(vars.view, 1, false, (float*)v);
     glUniformMatrix4fv(vars.projection, 1, false, (float*)p);
-    glDrawElements(
-        GL_TRIANGLES, model.meshes[0].n_triangles * 3, GL_UNSIGNED_INT, 0
-    );
+
+    // one draw per mesh, covering every node that uses it
+    FOR(bi, instances->n_batches) {
+      SceneBatch* batch = &instances->batches[bi];
+      Mesh* mesh        = &render.model.meshes[batch->mesh];
+      GlIdentifier* ids = resourceMesh(&registry, render.meshes[batch->mesh]);
+      if (!ids) continue;
+      VertexDequant* dq = &ids->dequant[0];
+      glUniform1i(vars.oct_normals, dq->oct_normals);
+      glUniform1i(vars.oct_tangents, dq->oct_tangents);
+
+      // the buffers may be shared with other models, so every batch
+      // uploads its own transforms
+      float* matrices     = instances->matrices[batch->first_instance];
+      InstanceRange range = {0, batch->n_instances};
+      syncInstances(ids, matrices, range.count);
+      glUniform3fv(vars.pos_offset, 1, dq->pos_offset);
+      glUniform3fv(vars.pos_scale, 1, dq->pos_scale);
+
+      // pick the level of detail from the distance to the bounds of the
+      // instance that needs the most, a camera inside them sees full
+      // detail. The lod errors are in object space, so the world distance
+      // is divided by the scale of the instance.
+      float distance = FLT_MAX;
+      FOR(k, range.count) {
+        mat4 world, mw;
+        memcpy(world, &matrices[16 * k], sizeof(world));
+        glm_mat4_mul(m, world, mw);
+        vec3 center;
+        glm_mat4_mulv3(mw, mesh->bounds.center, 1.0f, center);
+        float scale = 0.0f;
+        FOR(c, 3) {
+          float s = glm_vec3_norm(mw[c]);
+          if (s > scale) scale = s;
+        }
+        float d = glm_vec3_distance(state.camera.pos, center) -
+                  mesh->bounds.radius * scale;
+        if (scale > 0.0f && d / scale < distance) distance = d / scale;
+      }
+      int lod = selectMeshLod(
+          mesh, distance, lodErrorScale(fov, H), LOD_MAX_PIXEL_ERROR
+      );
+
+      // full resolution draws only submit the meshlets that can be seen,
+      // they are culled in the space of a single instance
+      MeshletRange* visible = render.visible;
+      if (CULL_MESHLETS && lod == 0 && mesh->n_meshlets && visible &&
+          range.count == 1) {
+        mat4 world, mw, vp, mvp, inv;
+        vec4 planes[6];
+        vec3 eye;
+        memcpy(world, matrices, sizeof(world));
+        glm_mat4_mul(m, world, mw);
+        glm_mat4_mul(p, v, vp);
+        glm_mat4_mul(vp, mw, mvp);
+        glm_frustum_planes(mvp, planes); // in object space
+        glm_mat4_inv(mw, inv);
+        glm_mat4_mulv3(inv, state.camera.pos, 1.0f, eye);
+        int n_visible = cullMeshlets(mesh, planes, eye, visible);
+        drawMeshlets(mesh, ids, 0, range, visible, n_visible);
+      } else {
+        drawMeshLod(mesh, ids, 0, lod, range);
+      }
+    }
 
     // glfw: swap buffers
     glfwSwapBuffers(w); // swap buffer
     glfwPollEvents();   // poll for more events
   }
+  if (watcher) destroyFileWatcher(watcher);
+
+// failures after the stream is created still release the model
+unload:
+  if (stream) destroyTextureStream(stream);
+  freeRenderModel(&registry, &render);
+  freeRegistry(&registry);
 
 // === Cleanup ===
 clean:
+  if (cache_stats) printAssetCacheStats();
+  if (report && report != stderr) fclose(report);
   glfwTerminate();
   if (!w) return -1; // glfw could not init window
   return 0;
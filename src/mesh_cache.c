@@ -0,0 +1,431 @@
+#define _DEFAULT_SOURCE
+#include "models/mesh_cache.h"
+#include "models/lod.h"
+#include "models/meshlet.h"
+#include "log.h"
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint64_t alignUp(uint64_t v) {
+  return (v + MESH_CACHE_ALIGNMENT - 1) & ~(uint64_t)(MESH_CACHE_ALIGNMENT - 1);
+}
+
+/// size in bytes of each blob kind for a mesh
+static uint64_t blobSize(const Mesh* m, CacheBlob blob) {
+  switch (blob) {
+  case CACHE_VERTICES:
+  case CACHE_NORMALS:
+  case CACHE_TANGENTS:
+  case CACHE_TEX_COORDS:
+    return (uint64_t)m->n_vertices * meshAttributeStride(m, blob);
+  case CACHE_INDICES:
+    return (uint64_t)m->n_triangles * 3 * indexSize(m->index_type);
+  case CACHE_MESHLETS: return (uint64_t)m->n_meshlets * sizeof(Meshlet);
+  default: break;
+  }
+  int l = blob - CACHE_LOD_INDICES;
+  if (0 <= l && l < m->n_lods)
+    return (uint64_t)m->lods[l].n_triangles * 3 * indexSize(m->index_type);
+  return 0;
+}
+
+static void* blobData(const Mesh* m, CacheBlob blob) {
+  switch (blob) {
+  case CACHE_VERTICES:
+  case CACHE_NORMALS:
+  case CACHE_TANGENTS:
+  case CACHE_TEX_COORDS: return (void*)meshAttribute(m, blob);
+  case CACHE_INDICES: return m->indices;
+  case CACHE_MESHLETS: return m->meshlets;
+  default: break;
+  }
+  int l = blob - CACHE_LOD_INDICES;
+  return 0 <= l && l < m->n_lods ? m->lods[l].indices : NULL;
+}
+
+static void setBlobData(Mesh* m, CacheBlob blob, void* data) {
+  // the formats are read first, quantized attributes stay encoded
+  if (blob < N_MESH_ATTRIBUTES && m->formats[blob].type != COMPONENT_F32) {
+    m->encoded[blob] = data;
+    return;
+  }
+  switch (blob) {
+  case CACHE_VERTICES: m->vertices = data; break;
+  case CACHE_NORMALS: m->normals = data; break;
+  case CACHE_TANGENTS: m->tangents = data; break;
+  case CACHE_TEX_COORDS: m->tex_coords = data; break;
+  case CACHE_INDICES: m->indices = data; break;
+  case CACHE_MESHLETS: m->meshlets = data; break;
+  default: break;
+  }
+  int l = blob - CACHE_LOD_INDICES;
+  if (0 <= l && l < m->n_lods) m->lods[l].indices = data;
+}
+
+static uint64_t imageSize(const ImageData* image) {
+  // the format enum doubles as channel count - 1
+  return (uint64_t)image->w * image->h * (image->format + 1);
+}
+
+/// hash of the source bytes and of every setting that changes the bake
+static bool sourceKey(const char* src_path, AssetKey* key) {
+  int fd = open(src_path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st)) {
+    close(fd);
+    return false;
+  }
+  size_t size = (size_t)st.st_size;
+  void* map   = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+  close(fd);
+  if (map == MAP_FAILED) return false;
+  *key = hashAsset(map, size, (AssetKey){0});
+  if (map) munmap(map, size);
+
+  const float settings[] = {
+      MESH_CACHE_VERSION,
+      MAX_MESH_LODS,
+      LOD_MIN_TRIANGLES,
+      LOD_MIN_REDUCTION,
+      MESHLET_MAX_VERTICES,
+      MESHLET_MAX_TRIANGLES,
+  };
+  *key = hashAsset(settings, sizeof(settings), *key);
+  return true;
+}
+
+static bool writePadded(FILE* f, uint64_t* cursor, uint64_t offset) {
+  static const char zeros[MESH_CACHE_ALIGNMENT] = {0};
+  while (*cursor < offset) {
+    uint64_t n = offset - *cursor;
+    if (n > sizeof(zeros)) n = sizeof(zeros);
+    if (fwrite(zeros, 1, n, f) != n) return false;
+    *cursor += n;
+  }
+  return true;
+}
+
+LoadModelRes writeModelCache(const char* path, AssetKey key, Model* model) {
+  CacheHeader header = {
+      .magic                 = MESH_CACHE_MAGIC,
+      .version               = MESH_CACHE_VERSION,
+      .key                   = key,
+      .n_meshes              = model->n_meshes,
+      .n_materials           = model->n_materials,
+      .n_nodes               = model->scene.n_nodes,
+      .n_instance_transforms = model->scene.n_instance_transforms,
+  };
+
+  CacheMesh* meshes   = calloc(model->n_meshes, sizeof(CacheMesh));
+  CacheImage* images  = calloc(model->n_materials, sizeof(CacheImage));
+  CacheNode* nodes    = calloc(header.n_nodes, sizeof(CacheNode));
+  LoadModelRes result = ERROR;
+  if ((model->n_meshes && !meshes) || (model->n_materials && !images) ||
+      (header.n_nodes && !nodes))
+    goto clean;
+
+  // I. lay out the blobs after the tables
+  uint64_t end = sizeof(CacheHeader) + model->n_meshes * sizeof(CacheMesh) +
+                 model->n_materials * sizeof(CacheImage) +
+                 header.n_nodes * sizeof(CacheNode) +
+                 header.n_instance_transforms * sizeof(float[16]);
+  FOR(mi, model->n_meshes) {
+    Mesh* m                = &model->meshes[mi];
+    meshes[mi].n_vertices  = m->n_vertices;
+    meshes[mi].n_triangles = m->n_triangles;
+    meshes[mi].index_type  = m->index_type;
+    meshes[mi].n_lods      = m->n_lods;
+    meshes[mi].n_meshlets  = m->n_meshlets;
+    meshes[mi].bounds      = m->bounds;
+    FOR(k, N_MESH_ATTRIBUTES) {
+      meshes[mi].component_type[k] = m->formats[k].type;
+      meshes[mi].normalized[k]     = m->formats[k].normalized;
+    }
+    FOR(l, m->n_lods) {
+      meshes[mi].lod_triangles[l] = m->lods[l].n_triangles;
+      meshes[mi].lod_error[l]     = m->lods[l].error;
+    }
+    FOR(b, N_CACHE_BLOBS) {
+      if (!blobData(m, b)) continue;
+      meshes[mi].offset[b] = alignUp(end);
+      end                  = meshes[mi].offset[b] + blobSize(m, b);
+    }
+  }
+  FOR(mi, model->n_materials) {
+    ImageData* image  = &model->materials[mi].textures[BASE].image;
+    images[mi].w      = image->w;
+    images[mi].h      = image->h;
+    images[mi].format = image->format;
+    if (!image->data) continue;
+    // materials that share an image share its blob
+    FOR(prev, mi) {
+      if (model->materials[prev].textures[BASE].image.data != image->data)
+        continue;
+      images[mi].offset = images[prev].offset;
+      break;
+    }
+    if (images[mi].offset) continue;
+    images[mi].offset = alignUp(end);
+    end               = images[mi].offset + imageSize(image);
+  }
+  FOR(ni, header.n_nodes) {
+    const SceneNode* node = &model->scene.nodes[ni];
+    nodes[ni].parent      = node->parent;
+    nodes[ni].first_mesh  = node->first_mesh;
+    nodes[ni].n_meshes    = node->n_meshes;
+    nodes[ni].n_instances = node->n_instances;
+    memcpy(nodes[ni].local, node->local, sizeof(node->local));
+  }
+
+  // II. write everything to a temporary file and move it in place,
+  // such that a crash never leaves a half written cache behind
+  char tmp_path[1024];
+  FILE* f = beginAsset(path, tmp_path, sizeof(tmp_path));
+  if (!f) goto clean;
+
+  uint64_t cursor = 0;
+  bool ok         = fwrite(&header, sizeof(header), 1, f) == 1;
+  cursor += sizeof(header);
+  if (model->n_meshes)
+    ok = ok && fwrite(meshes, sizeof(CacheMesh), model->n_meshes, f) ==
+                   (size_t)model->n_meshes;
+  cursor += model->n_meshes * sizeof(CacheMesh);
+  if (model->n_materials)
+    ok = ok && fwrite(images, sizeof(CacheImage), model->n_materials, f) ==
+                   (size_t)model->n_materials;
+  cursor += model->n_materials * sizeof(CacheImage);
+  if (header.n_nodes)
+    ok = ok && fwrite(nodes, sizeof(CacheNode), header.n_nodes, f) ==
+                   header.n_nodes;
+  cursor += header.n_nodes * sizeof(CacheNode);
+  size_t n_transforms = header.n_instance_transforms;
+  if (n_transforms)
+    ok = ok && fwrite(
+                   model->scene.instance_transforms,
+                   sizeof(float[16]),
+                   n_transforms,
+                   f
+               ) == n_transforms;
+  cursor += n_transforms * sizeof(float[16]);
+
+  for (int mi = 0; ok && mi < model->n_meshes; mi++) {
+    Mesh* m = &model->meshes[mi];
+    for (int b = 0; ok && b < N_CACHE_BLOBS; b++) {
+      if (!meshes[mi].offset[b]) continue;
+      uint64_t size = blobSize(m, b);
+      ok = writePadded(f, &cursor, meshes[mi].offset[b]) &&
+           fwrite(blobData(m, b), 1, size, f) == size;
+      cursor += size;
+    }
+  }
+  for (int mi = 0; ok && mi < model->n_materials; mi++) {
+    // written in order of their offsets, shared blobs are skipped
+    if (!images[mi].offset || images[mi].offset < cursor) continue;
+    ImageData* image = &model->materials[mi].textures[BASE].image;
+    uint64_t size    = imageSize(image);
+    ok = writePadded(f, &cursor, images[mi].offset) &&
+         fwrite(image->data, 1, size, f) == size;
+    cursor += size;
+  }
+
+  if (endAsset(ASSET_MESH, f, tmp_path, path, ok)) result = SUCCESS;
+
+clean:
+  free(meshes);
+  free(images);
+  free(nodes);
+  return result;
+}
+
+LoadModelRes loadModelFromCache(
+    const char* path, AssetKey key, Model* model
+) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return ERROR;
+  struct stat st;
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(CacheHeader)) {
+    close(fd);
+    return ERROR;
+  }
+  size_t size = (size_t)st.st_size;
+  char* map   = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return ERROR;
+
+  // the tables live in an arena of their own until the cache is accepted
+  Arena arena         = {0};
+  Mesh* meshes        = NULL;
+  Material* materials = NULL;
+  SceneNode* nodes    = NULL;
+
+  // a foreign or damaged file is simply ignored
+  const CacheHeader* header = (const CacheHeader*)map;
+  if (header->magic != MESH_CACHE_MAGIC ||
+      header->version != MESH_CACHE_VERSION || header->key.lo != key.lo ||
+      header->key.hi != key.hi)
+    goto fail;
+
+  uint64_t tables_end = sizeof(CacheHeader) +
+                        (uint64_t)header->n_meshes * sizeof(CacheMesh) +
+                        (uint64_t)header->n_materials * sizeof(CacheImage) +
+                        (uint64_t)header->n_nodes * sizeof(CacheNode) +
+                        (uint64_t)header->n_instance_transforms *
+                            sizeof(float[16]);
+  if (tables_end > size) goto fail;
+  const CacheMesh* cache_meshes =
+      (const CacheMesh*)(map + sizeof(CacheHeader));
+  const CacheImage* cache_images =
+      (const CacheImage*)(cache_meshes + header->n_meshes);
+  const CacheNode* cache_nodes =
+      (const CacheNode*)(cache_images + header->n_materials);
+  float(*transforms)[16] = (float(*)[16])(cache_nodes + header->n_nodes);
+
+  meshes    = arenaCalloc(&arena, header->n_meshes, sizeof(Mesh));
+  materials = arenaCalloc(&arena, header->n_materials, sizeof(Material));
+  nodes     = arenaCalloc(&arena, header->n_nodes, sizeof(SceneNode));
+
+  FOR(mi, header->n_meshes) {
+    Mesh* m        = &meshes[mi];
+    m->n_vertices  = cache_meshes[mi].n_vertices;
+    m->n_triangles = cache_meshes[mi].n_triangles;
+    m->index_type  = cache_meshes[mi].index_type;
+    m->n_lods      = cache_meshes[mi].n_lods;
+    m->n_meshlets  = cache_meshes[mi].n_meshlets;
+    m->bounds      = cache_meshes[mi].bounds;
+    if ((unsigned)m->index_type >= N_INDEX_TYPES ||
+        (unsigned)m->n_lods > MAX_MESH_LODS || m->n_meshlets < 0)
+      goto fail;
+    FOR(k, N_MESH_ATTRIBUTES) {
+      m->formats[k].type       = cache_meshes[mi].component_type[k];
+      m->formats[k].normalized = cache_meshes[mi].normalized[k];
+      if ((unsigned)m->formats[k].type >= N_COMPONENT_TYPES) goto fail;
+    }
+    FOR(l, m->n_lods) {
+      m->lods[l].n_triangles = cache_meshes[mi].lod_triangles[l];
+      m->lods[l].error       = cache_meshes[mi].lod_error[l];
+    }
+    FOR(b, N_CACHE_BLOBS) {
+      uint64_t offset = cache_meshes[mi].offset[b];
+      if (!offset) continue;
+      if (offset + blobSize(m, b) > size) goto fail;
+      setBlobData(m, b, map + offset);
+    }
+    if (!m->meshlets) m->n_meshlets = 0;
+  }
+  FOR(mi, header->n_materials) {
+    ImageData* image = &materials[mi].textures[BASE].image;
+    image->w         = cache_images[mi].w;
+    image->h         = cache_images[mi].h;
+    image->format    = cache_images[mi].format;
+    uint64_t offset  = cache_images[mi].offset;
+    if (!offset) continue;
+    if (offset + imageSize(image) > size) goto fail;
+    image->data = (unsigned char*)map + offset;
+  }
+  int n_transforms = 0;
+  FOR(ni, header->n_nodes) {
+    SceneNode* node      = &nodes[ni];
+    node->parent         = cache_nodes[ni].parent;
+    node->first_mesh     = cache_nodes[ni].first_mesh;
+    node->n_meshes       = cache_nodes[ni].n_meshes;
+    node->first_instance = n_transforms;
+    node->n_instances    = cache_nodes[ni].n_instances;
+    memcpy(node->local, cache_nodes[ni].local, sizeof(node->local));
+    // parents first, and only meshes and instances that exist
+    int end = node->first_mesh + node->n_meshes;
+    if (node->parent >= ni || node->n_meshes < 0 ||
+        (node->n_meshes &&
+         (node->first_mesh < 0 || end > (int)header->n_meshes)))
+      goto fail;
+    if (node->n_instances < 0 ||
+        node->n_instances > (int)header->n_instance_transforms - n_transforms)
+      goto fail;
+    n_transforms += node->n_instances;
+  }
+
+  // the whole file is about to be uploaded, start reading it in now
+  madvise(map, size, MADV_WILLNEED);
+
+  model->n_meshes     = header->n_meshes;
+  model->n_materials  = header->n_materials;
+  model->meshes       = meshes;
+  model->materials    = materials;
+  model->scene        = (Scene){
+      header->n_nodes, nodes, header->n_instance_transforms, transforms
+  };
+  model->mapping      = map;
+  model->mapping_size = size;
+  model->arena        = arena;
+  updateSceneTransforms(&model->scene);
+  return SUCCESS;
+
+fail:
+  arena_free(&arena);
+  munmap(map, size);
+  return ERROR;
+}
+
+void releaseModelCache(Model* model) {
+  if (!model->mapping) return;
+  munmap(model->mapping, model->mapping_size);
+  model->mapping      = NULL;
+  model->mapping_size = 0;
+}
+
+/// loads `path`, every phase is added to `report`
+static LoadModelRes importModel(
+    const char* path, Model* model, ImportReport* report
+) {
+  AssetKey key;
+  char cache_path[1024];
+  ClockReading t = readClock();
+  if (!sourceKey(path, &key) ||
+      !assetPath(cache_path, sizeof(cache_path), ASSET_MESH, key))
+    return loadModelFromGltfFile(path, model, report);
+
+  if (loadModelFromCache(cache_path, key, model) == SUCCESS) {
+    endPhase(report, PHASE_CACHE_LOAD, t);
+    assetHit(ASSET_MESH, cache_path, model->mapping_size);
+    report->cached = true;
+    LOG_INFO("> loaded %s from mesh cache\n", path);
+    return SUCCESS;
+  }
+  endPhase(report, PHASE_CACHE_LOAD, t);
+  assetMiss(ASSET_MESH);
+
+  LoadModelRes res = loadModelFromGltfFile(path, model, report);
+  if (res != SUCCESS) return res;
+  t = readClock();
+  if (writeModelCache(cache_path, key, model) != SUCCESS)
+    LOG(LOG_LEVEL_ERROR, "> could not write mesh cache %s\n", cache_path);
+  endPhase(report, PHASE_CACHE_WRITE, t);
+  return SUCCESS;
+}
+
+LoadModelRes loadModel(
+    const char* path, Model* model, ImportReport* report
+) {
+  ImportReport unused = {0};
+  if (!report) report = &unused;
+  *report          = (ImportReport){.path = path};
+  ClockReading t   = readClock();
+  LoadModelRes res = importModel(path, model, report);
+  addPhaseTime(&report->total, t, readClock());
+
+  // the loading thread only measures itself, the total counts every thread
+  report->total.cpu = 0.0;
+  FOR(p, N_IMPORT_PHASES) report->total.cpu += report->phases[p].cpu;
+  report->success = res == SUCCESS;
+  if (report->success) {
+    report->n_meshes = model->n_meshes;
+    report->n_nodes  = model->scene.n_nodes;
+  }
+  return res;
+}
@@ -0,0 +1,336 @@
+#include "models/mesh_optimize.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the LRU cache Forsyth's scoring is tuned for
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_MAX_VALENCE 32
+
+uint32_t* widenIndices(const Mesh* m) {
+  if (!m->indices) return NULL;
+  int n         = m->n_triangles * 3;
+  uint32_t* dst = malloc(n * sizeof(uint32_t));
+  if (dst) copyIndices(dst, INDEX_U32, m->indices, m->index_type, n);
+  return dst;
+}
+
+// === analysis ===
+
+VertexCacheStats
+analyzeVertexCache(const uint32_t* indices, int n_indices, int n_vertices) {
+  VertexCacheStats stats = {0};
+  // FIFO cache, a vertex is cached while it was inserted less than
+  // ANALYZE_CACHE_SIZE insertions ago
+  unsigned int* inserted = calloc(n_vertices, sizeof(unsigned int));
+  if (!inserted || n_indices < 3) {
+    free(inserted);
+    return stats;
+  }
+  unsigned int time = ANALYZE_CACHE_SIZE + 1;
+  int misses        = 0;
+  FOR(i, n_indices) {
+    uint32_t v = indices[i];
+    if (time - inserted[v] > ANALYZE_CACHE_SIZE) {
+      inserted[v] = time++;
+      misses++;
+    }
+  }
+  free(inserted);
+  stats.acmr = (float)misses / (n_indices / 3);
+  stats.atvr = n_vertices ? (float)misses / n_vertices : 0.0f;
+  return stats;
+}
+
+// === vertex cache ===
+
+static float cache_scores[FORSYTH_CACHE_SIZE + 1];
+static float valence_scores[FORSYTH_MAX_VALENCE + 1];
+static pthread_once_t scores_once = PTHREAD_ONCE_INIT;
+
+/// tables of Forsyth's scoring function
+static void initForsythScores(void) {
+  // the last three vertices belong to the previous triangle, using them
+  // again is cheap, but it is better to move on a bit
+  FOR(p, FORSYTH_CACHE_SIZE) {
+    float s = 1.0f - (p - 3) * (1.0f / (FORSYTH_CACHE_SIZE - 3));
+    cache_scores[p] = p < 3 ? 0.75f : powf(s, 1.5f);
+  }
+  cache_scores[FORSYTH_CACHE_SIZE] = 0.0f; // not cached
+  // vertices with few triangles left are finished first
+  valence_scores[0] = 0.0f;
+  for (int l = 1; l <= FORSYTH_MAX_VALENCE; l++)
+    valence_scores[l] = 2.0f * powf((float)l, -0.5f);
+}
+
+static inline float vertexScore(int cache_pos, int live) {
+  if (live == 0) return -1.0f;
+  if (live > FORSYTH_MAX_VALENCE) live = FORSYTH_MAX_VALENCE;
+  return cache_scores[cache_pos] + valence_scores[live];
+}
+
+void optimizeVertexCache(uint32_t* indices, int n_indices, int n_vertices) {
+  int n_triangles = n_indices / 3;
+  if (n_triangles == 0) return;
+  pthread_once(&scores_once, initForsythScores);
+
+  // triangle adjacency of every vertex
+  int* live       = calloc(n_vertices, sizeof(int));
+  int* offsets    = calloc(n_vertices + 1, sizeof(int));
+  int* adjacency  = malloc(n_indices * sizeof(int));
+  float* v_scores = malloc(n_vertices * sizeof(float));
+  float* t_scores = malloc(n_triangles * sizeof(float));
+  bool* emitted   = calloc(n_triangles, sizeof(bool));
+  uint32_t* out   = malloc(n_indices * sizeof(uint32_t));
+  if (!live || !offsets || !adjacency || !v_scores || !t_scores || !emitted ||
+      !out)
+    goto clean;
+
+  FOR(i, n_indices) live[indices[i]]++;
+  FOR(v, n_vertices) offsets[v + 1] = offsets[v] + live[v];
+  FOR(v, n_vertices) live[v] = 0;
+  FOR(i, n_indices) {
+    uint32_t v                        = indices[i];
+    adjacency[offsets[v] + live[v]++] = i / 3;
+  }
+
+  FOR(v, n_vertices) v_scores[v] = vertexScore(FORSYTH_CACHE_SIZE, live[v]);
+  int best = 0;
+  FOR(t, n_triangles) {
+    const uint32_t* tri = &indices[t * 3];
+    t_scores[t] = v_scores[tri[0]] + v_scores[tri[1]] + v_scores[tri[2]];
+    if (t_scores[t] > t_scores[best]) best = t;
+  }
+
+  // the cache gets three extra slots for the vertices pushed out by the
+  // emitted triangle, whose scores still have to be updated
+  uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+  int cache_n = 0;
+  int cursor  = 0; // every triangle before it has been emitted
+
+  FOR(o, n_triangles) {
+    if (best < 0) {
+      // nothing in the cache is adjacent to a triangle left, restart
+      while (emitted[cursor]) cursor++;
+      best = cursor;
+    }
+    const uint32_t* tri = &indices[best * 3];
+    memcpy(&out[o * 3], tri, 3 * sizeof(uint32_t));
+    emitted[best] = true;
+
+    // the triangle is no longer live for its vertices
+    FOR(k, 3) {
+      uint32_t v = tri[k];
+      int* adj   = &adjacency[offsets[v]];
+      FOR(a, live[v]) {
+        if (adj[a] != best) continue;
+        adj[a] = adj[--live[v]];
+        break;
+      }
+    }
+
+    // move its vertices to the front of the cache
+    uint32_t next[FORSYTH_CACHE_SIZE + 3];
+    int next_n = 0;
+    FOR(k, 3) next[next_n++] = tri[k];
+    FOR(c, cache_n) {
+      uint32_t v = cache[c];
+      if (v != tri[0] && v != tri[1] && v != tri[2]) next[next_n++] = v;
+    }
+
+    // rescore the cached (and evicted) vertices and their triangles
+    best             = -1;
+    float best_score = -1.0f;
+    FOR(c, next_n) {
+      uint32_t v     = next[c];
+      int p          = c < FORSYTH_CACHE_SIZE ? c : FORSYTH_CACHE_SIZE;
+      float score    = vertexScore(p, live[v]);
+      float delta    = score - v_scores[v];
+      v_scores[v]    = score;
+      const int* adj = &adjacency[offsets[v]];
+      FOR(a, live[v]) {
+        int t = adj[a];
+        t_scores[t] += delta;
+        if (t_scores[t] > best_score) {
+          best_score = t_scores[t];
+          best       = t;
+        }
+      }
+    }
+    cache_n = next_n < FORSYTH_CACHE_SIZE ? next_n : FORSYTH_CACHE_SIZE;
+    memcpy(cache, next, cache_n * sizeof(uint32_t));
+  }
+  memcpy(indices, out, n_indices * sizeof(uint32_t));
+
+clean:
+  free(live);
+  free(offsets);
+  free(adjacency);
+  free(v_scores);
+  free(t_scores);
+  free(emitted);
+  free(out);
+}
+
+// === overdraw ===
+
+typedef struct {
+  float key;
+  int start; // first triangle
+  int count;
+} Cluster;
+
+static int compareClusters(const void* a, const void* b) {
+  float ka = ((const Cluster*)a)->key;
+  float kb = ((const Cluster*)b)->key;
+  return (ka < kb) - (ka > kb); // descending
+}
+
+void optimizeOverdraw(
+    uint32_t* indices, int n_indices, const float* positions, int n_vertices
+) {
+  int n_triangles = n_indices / 3;
+  if (n_triangles == 0 || !positions) return;
+
+  unsigned int* inserted = calloc(n_vertices, sizeof(unsigned int));
+  Cluster* clusters      = malloc(n_triangles * sizeof(Cluster));
+  uint32_t* out          = malloc(n_indices * sizeof(uint32_t));
+  if (!inserted || !clusters || !out) goto clean;
+
+  // clusters start where the cache order had to start over, i.e. where
+  // all three vertices miss. Reordering whole clusters keeps the cache
+  // efficiency of the previous pass.
+  int n_clusters    = 0;
+  unsigned int time = ANALYZE_CACHE_SIZE + 1;
+  FOR(t, n_triangles) {
+    int misses = 0;
+    FOR(k, 3) {
+      uint32_t v = indices[t * 3 + k];
+      if (time - inserted[v] > ANALYZE_CACHE_SIZE) {
+        inserted[v] = time++;
+        misses++;
+      }
+    }
+    if (t == 0 || misses == 3) clusters[n_clusters++] = (Cluster){0, t, 0};
+    clusters[n_clusters - 1].count++;
+  }
+
+  // clusters facing away from the center are likely to occlude the rest,
+  // so they are drawn first
+  double center[3] = {0};
+  FOR(v, n_vertices) FOR(k, 3) center[k] += positions[v * 3 + k];
+  FOR(k, 3) center[k] /= n_vertices ? n_vertices : 1;
+
+  FOR(c, n_clusters) {
+    float centroid[3] = {0}, normal[3] = {0}, area = 0.0f;
+    FOR(t, clusters[c].count) {
+      const uint32_t* tri = &indices[(clusters[c].start + t) * 3];
+      const float* p0     = &positions[tri[0] * 3];
+      const float* p1     = &positions[tri[1] * 3];
+      const float* p2     = &positions[tri[2] * 3];
+      float e1[3], e2[3];
+      FOR(k, 3) {
+        e1[k] = p1[k] - p0[k];
+        e2[k] = p2[k] - p0[k];
+      }
+      // the cross product is the area weighted normal
+      float n[3] = {
+          e1[1] * e2[2] - e1[2] * e2[1],
+          e1[2] * e2[0] - e1[0] * e2[2],
+          e1[0] * e2[1] - e1[1] * e2[0],
+      };
+      float a = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      FOR(k, 3) {
+        normal[k] += n[k];
+        centroid[k] += (p0[k] + p1[k] + p2[k]) * (a / 3.0f);
+      }
+      area += a;
+    }
+    float len = sqrtf(
+        normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]
+    );
+    float key = 0.0f;
+    if (area > 0.0f && len > 0.0f)
+      FOR(k, 3) key += (centroid[k] / area - center[k]) * (normal[k] / len);
+    clusters[c].key = key;
+  }
+  qsort(clusters, n_clusters, sizeof(Cluster), compareClusters);
+
+  int o = 0;
+  FOR(c, n_clusters) {
+    int n = clusters[c].count * 3;
+    memcpy(&out[o], &indices[clusters[c].start * 3], n * sizeof(uint32_t));
+    o += n;
+  }
+  memcpy(indices, out, n_indices * sizeof(uint32_t));
+
+clean:
+  free(inserted);
+  free(clusters);
+  free(out);
+}
+
+// === vertex fetch ===
+
+/// moves element `v` of `data` to `remap[v]`, `n_comp` floats each
+static void
+remapAttribute(float* data, int n_comp, const int* remap, int n, float* tmp) {
+  if (!data) return;
+  memcpy(tmp, data, (size_t)n * n_comp * sizeof(float));
+  FOR(v, n) {
+    if (remap[v] < 0) continue;
+    memcpy(&data[remap[v] * n_comp], &tmp[v * n_comp], n_comp * sizeof(float));
+  }
+}
+
+int optimizeVertexFetch(Mesh* m, uint32_t* indices, int n_indices) {
+  int n      = m->n_vertices;
+  int* remap = malloc(n * sizeof(int));
+  float* tmp = malloc((size_t)n * 4 * sizeof(float));
+  if (!remap || !tmp) {
+    free(remap);
+    free(tmp);
+    return n;
+  }
+
+  // number the vertices in the order they are first used
+  FOR(v, n) remap[v] = -1;
+  int n_used = 0;
+  FOR(i, n_indices) {
+    uint32_t v = indices[i];
+    if (remap[v] < 0) remap[v] = n_used++;
+    indices[i] = remap[v];
+  }
+
+  // the arrays are compacted in place, such that ownership is unchanged
+  remapAttribute(m->vertices, 3, remap, n, tmp);
+  remapAttribute(m->normals, 3, remap, n, tmp);
+  remapAttribute(m->tangents, 4, remap, n, tmp);
+  remapAttribute(m->tex_coords, 2, remap, n, tmp);
+  m->n_vertices = n_used;
+
+  free(remap);
+  free(tmp);
+  return n_used;
+}
+
+MeshOptStats optimizeMesh(Mesh* m) {
+  MeshOptStats stats = {0};
+  if (!m->indices || !m->vertices) return stats;
+
+  int n_indices     = m->n_triangles * 3;
+  uint32_t* indices = widenIndices(m);
+  if (!indices) return stats;
+  stats.before = analyzeVertexCache(indices, n_indices, m->n_vertices);
+
+  optimizeVertexCache(indices, n_indices, m->n_vertices);
+  optimizeOverdraw(indices, n_indices, m->vertices, m->n_vertices);
+  optimizeVertexFetch(m, indices, n_indices);
+
+  stats.after = analyzeVertexCache(indices, n_indices, m->n_vertices);
+  copyIndices(m->indices, m->index_type, indices, INDEX_U32, n_indices);
+  free(indices);
+  return stats;
+}
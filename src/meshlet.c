@@ -0,0 +1,180 @@
+#include "models/meshlet.h"
+#include "models/mesh_optimize.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// cones wider than this (cosine of the half angle) can never be culled,
+// so they are not worth testing
+#define MIN_CONE_SPREAD 0.1f
+
+static void computeBounds(
+    Meshlet* ml, const float* positions, const uint32_t* indices
+) {
+  const uint32_t* tris = &indices[ml->first_triangle * 3];
+  int n                = ml->n_triangles * 3;
+
+  // I. bounding sphere around the center of the bounding box
+  float lo[3] = {INFINITY, INFINITY, INFINITY};
+  float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+  FOR(i, n) FOR(k, 3) {
+    float p = positions[tris[i] * 3 + k];
+    lo[k]   = p < lo[k] ? p : lo[k];
+    hi[k]   = p > hi[k] ? p : hi[k];
+  }
+  float radius_sq = 0.0f;
+  FOR(k, 3) ml->center[k] = (lo[k] + hi[k]) * 0.5f;
+  FOR(i, n) {
+    const float* p = &positions[tris[i] * 3];
+    float d[3]     = {
+        p[0] - ml->center[0], p[1] - ml->center[1], p[2] - ml->center[2]
+    };
+    float d_sq = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+    radius_sq  = d_sq > radius_sq ? d_sq : radius_sq;
+  }
+  ml->radius = sqrtf(radius_sq);
+
+  // II. normal cone around the average triangle normal
+  float axis[3]      = {0};
+  float(*normals)[3] = malloc(ml->n_triangles * sizeof(*normals));
+  ml->cone_cutoff    = 1.0f;
+  if (!normals) return;
+  FOR(t, ml->n_triangles) {
+    const float* p0 = &positions[tris[t * 3 + 0] * 3];
+    const float* p1 = &positions[tris[t * 3 + 1] * 3];
+    const float* p2 = &positions[tris[t * 3 + 2] * 3];
+    float e1[3], e2[3];
+    FOR(k, 3) {
+      e1[k] = p1[k] - p0[k];
+      e2[k] = p2[k] - p0[k];
+    }
+    float* nt = normals[t];
+    nt[0]     = e1[1] * e2[2] - e1[2] * e2[1];
+    nt[1]     = e1[2] * e2[0] - e1[0] * e2[2];
+    nt[2]     = e1[0] * e2[1] - e1[1] * e2[0];
+    float len = sqrtf(nt[0] * nt[0] + nt[1] * nt[1] + nt[2] * nt[2]);
+    FOR(k, 3) nt[k] = len > 0.0f ? nt[k] / len : 0.0f;
+    FOR(k, 3) axis[k] += nt[k];
+  }
+  float len = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  if (len == 0.0f) goto clean;
+  FOR(k, 3) axis[k] /= len;
+
+  // the widest angle between the axis and a triangle normal
+  float min_dp = 1.0f;
+  FOR(t, ml->n_triangles) {
+    const float* nt = normals[t];
+    float dp        = nt[0] * axis[0] + nt[1] * axis[1] + nt[2] * axis[2];
+    min_dp          = dp < min_dp ? dp : min_dp;
+  }
+  if (min_dp <= MIN_CONE_SPREAD) goto clean;
+
+  // the apex is moved back along the axis until every triangle plane is
+  // in front of it, then the view direction to the apex can be tested
+  float max_t = 0.0f;
+  FOR(t, ml->n_triangles) {
+    const float* nt = normals[t];
+    const float* p0 = &positions[tris[t * 3] * 3];
+    float dc        = 0.0f, dn = 0.0f;
+    FOR(k, 3) {
+      dc += (ml->center[k] - p0[k]) * nt[k];
+      dn += axis[k] * nt[k];
+    }
+    max_t = dc / dn > max_t ? dc / dn : max_t;
+  }
+  FOR(k, 3) {
+    ml->cone_apex[k] = ml->center[k] - axis[k] * max_t;
+    ml->cone_axis[k] = axis[k];
+  }
+  ml->cone_cutoff = sqrtf(1.0f - min_dp * min_dp);
+
+clean:
+  free(normals);
+}
+
+void buildMeshlets(Mesh* m, Arena* arena) {
+  m->n_meshlets = 0;
+  m->meshlets   = NULL;
+  if (!m->indices || !m->vertices || m->n_triangles == 0) return;
+
+  uint32_t* indices = widenIndices(m);
+  // the meshlet each vertex was last added to
+  int* stamp = malloc(m->n_vertices * sizeof(int));
+  // every meshlet has at least one triangle
+  Meshlet* meshlets = malloc(m->n_triangles * sizeof(Meshlet));
+  if (!indices || !stamp || !meshlets) goto clean;
+  FOR(v, m->n_vertices) stamp[v] = -1;
+
+  // greedily fill meshlets in index order, the cache optimized order
+  // keeps consecutive triangles close to each other
+  int n          = 0;
+  Meshlet* ml    = NULL;
+  int n_vertices = 0;
+  FOR(t, m->n_triangles) {
+    const uint32_t* tri = &indices[t * 3];
+    int n_new           = 0;
+    FOR(k, 3) n_new += ml && stamp[tri[k]] == n - 1 ? 0 : 1;
+    if (!ml || n_vertices + n_new > MESHLET_MAX_VERTICES ||
+        ml->n_triangles == MESHLET_MAX_TRIANGLES) {
+      ml         = &meshlets[n++];
+      *ml        = (Meshlet){.first_triangle = t};
+      n_vertices = 0;
+    }
+    FOR(k, 3) {
+      if (stamp[tri[k]] == n - 1) continue;
+      stamp[tri[k]] = n - 1;
+      n_vertices++;
+    }
+    ml->n_triangles++;
+  }
+  FOR(i, n) computeBounds(&meshlets[i], m->vertices, indices);
+
+  // only the used part is kept
+  m->meshlets =
+      arenaAllocAligned(arena, n * sizeof(Meshlet), MODEL_ALIGNMENT);
+  m->n_meshlets = n;
+  memcpy(m->meshlets, meshlets, n * sizeof(Meshlet));
+
+clean:
+  free(indices);
+  free(stamp);
+  free(meshlets);
+}
+
+int cullMeshlets(
+    const Mesh* m, float planes[6][4], const float eye[3],
+    MeshletRange* out
+) {
+  int n = 0;
+  FOR(i, m->n_meshlets) {
+    const Meshlet* ml = &m->meshlets[i];
+    const float* c    = ml->center;
+
+    // outside of one of the planes
+    bool visible = true;
+    for (int p = 0; visible && p < 6; p++) {
+      const float* pl = planes[p];
+      float d         = pl[0] * c[0] + pl[1] * c[1] + pl[2] * c[2] + pl[3];
+      visible         = d >= -ml->radius;
+    }
+
+    // facing away
+    if (visible && ml->cone_cutoff < 1.0f) {
+      float v[3];
+      FOR(k, 3) v[k] = ml->cone_apex[k] - eye[k];
+      float len = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+      float dp  = v[0] * ml->cone_axis[0] + v[1] * ml->cone_axis[1] +
+                 v[2] * ml->cone_axis[2];
+      visible = dp < ml->cone_cutoff * len;
+    }
+    if (!visible) continue;
+
+    // meshlets are consecutive in the index buffer, so neighbours merge
+    if (n && out[n - 1].first_triangle + out[n - 1].n_triangles ==
+                 ml->first_triangle)
+      out[n - 1].n_triangles += ml->n_triangles;
+    else out[n++] = (MeshletRange){ml->first_triangle, ml->n_triangles};
+  }
+  return n;
+}
@@ -0,0 +1,627 @@
+#include "models/meshopt_decode.h"
+#include "simd.h"
+#include "util.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// high nibble of the first byte of each stream, the low nibble is the
+// version
+#define VERTEX_HEADER 0xa0
+#define TRIANGLE_HEADER 0xe0
+#define SEQUENCE_HEADER 0xd0
+
+// vertices are coded in blocks of at most this many bytes and vertices
+#define VERTEX_BLOCK_BYTES 8192
+#define VERTEX_BLOCK_MAX 256
+// bytes per group, and the most a group reads from the stream
+#define BYTE_GROUP 16
+#define BYTE_GROUP_READ 24
+// the stream ends in a tail of at least this size, holding the first
+// vertex in its last bytes
+#define VERTEX_TAIL_MIN 32
+
+// === byte groups ===
+
+/// next value of a group with `bits` bits per byte, escaped values are
+/// read from `escaped`
+#define NEXT_VALUE(bits)                                                       \
+  do {                                                                         \
+    int v = byte >> (8 - (bits));                                              \
+    byte  = (uint8_t)(byte << (bits));                                         \
+    bool escape = v == (1 << (bits)) - 1;                                      \
+    *out++      = escape ? *escaped : v;                                       \
+    escaped += escape;                                                         \
+  } while (0)
+
+/// unpacks 16 bytes stored with 2^bits_log2 bits each, bytes that do not
+/// fit are escaped with all bits set and follow the packed ones. The first
+/// value is in the high bits.
+static const uint8_t* decodeByteGroup(
+    const uint8_t* data, uint8_t* out, int bits_log2
+) {
+  const uint8_t* escaped;
+  switch (bits_log2) {
+  case 0: memset(out, 0, BYTE_GROUP); return data;
+  case 1:
+    escaped = data + 4;
+    FOR(i, 4) {
+      uint8_t byte = data[i];
+      NEXT_VALUE(2);
+      NEXT_VALUE(2);
+      NEXT_VALUE(2);
+      NEXT_VALUE(2);
+    }
+    return escaped;
+  case 2:
+    escaped = data + 8;
+    FOR(i, 8) {
+      uint8_t byte = data[i];
+      NEXT_VALUE(4);
+      NEXT_VALUE(4);
+    }
+    return escaped;
+  default: memcpy(out, data, BYTE_GROUP); return data + BYTE_GROUP;
+  }
+}
+#undef NEXT_VALUE
+
+#if defined(SIMD_DISPATCH)
+// for every mask of 8 escaped bytes, where each byte comes from in the
+// escaped bytes (0x80 zeroes it), and how many are escaped
+static uint8_t group_shuffle[256][8];
+static uint8_t group_count[256];
+static pthread_once_t group_tables_once = PTHREAD_ONCE_INIT;
+// the build may not include SSSE3, the cpu is asked once
+static bool group_simd;
+
+static void buildGroupTables(void) {
+  group_simd = __builtin_cpu_supports("ssse3");
+  FOR(mask, 256) {
+    uint8_t count = 0;
+    FOR(i, 8) {
+      bool escaped           = (mask >> i) & 1;
+      group_shuffle[mask][i] = escaped ? count : 0x80;
+      count += escaped;
+    }
+    group_count[mask] = count;
+  }
+}
+
+/// `decodeByteGroup` for the 2 and 4 bit groups, `packed` bytes hold the
+/// values
+SIMD_TARGET("ssse3") static const uint8_t* decodeByteGroupSimd(
+    const uint8_t* data, uint8_t* out, int bits_log2
+) {
+  __m128i sel;
+  int packed;
+  if (bits_log2 == 1) {
+    int32_t word;
+    memcpy(&word, data, sizeof(word));
+    // spread the 4 values of every byte into a byte each, high bits first
+    __m128i s   = _mm_cvtsi32_si128(word);
+    __m128i s2  = _mm_unpacklo_epi8(_mm_srli_epi16(s, 4), s);
+    __m128i s22 = _mm_unpacklo_epi8(_mm_srli_epi16(s2, 2), s2);
+    sel         = _mm_and_si128(s22, _mm_set1_epi8(3));
+    packed      = 4;
+  } else {
+    __m128i s  = _mm_loadl_epi64((const __m128i*)data);
+    __m128i s4 = _mm_unpacklo_epi8(_mm_srli_epi16(s, 4), s);
+    sel        = _mm_and_si128(s4, _mm_set1_epi8(15));
+    packed     = 8;
+  }
+  __m128i escape = _mm_set1_epi8(bits_log2 == 1 ? 3 : 15);
+  __m128i mask   = _mm_cmpeq_epi8(sel, escape);
+  int bits       = _mm_movemask_epi8(mask);
+  int lo         = bits & 255;
+  int hi         = bits >> 8;
+
+  // the escaped bytes of the high half follow those of the low half
+  __m128i shuf_lo = _mm_loadl_epi64((const __m128i*)group_shuffle[lo]);
+  __m128i shuf_hi = _mm_loadl_epi64((const __m128i*)group_shuffle[hi]);
+  shuf_hi = _mm_add_epi8(shuf_hi, _mm_set1_epi8(group_count[lo]));
+  __m128i shuf = _mm_unpacklo_epi64(shuf_lo, shuf_hi);
+
+  __m128i rest   = _mm_loadu_si128((const __m128i*)(data + packed));
+  __m128i result = _mm_or_si128(
+      _mm_shuffle_epi8(rest, shuf), _mm_andnot_si128(mask, sel)
+  );
+  _mm_storeu_si128((__m128i*)out, result);
+  return data + packed + group_count[lo] + group_count[hi];
+}
+#endif
+
+/// `n` bytes (a multiple of BYTE_GROUP) of one channel, NULL when the
+/// stream is too short
+static const uint8_t* decodeByteStream(
+    const uint8_t* data, const uint8_t* end, uint8_t* out, int n
+) {
+  // 2 bits per group pick its width
+  int n_groups    = n / BYTE_GROUP;
+  int header_size = (n_groups + 3) / 4;
+  if (end - data < header_size) return NULL;
+  const uint8_t* header = data;
+  data += header_size;
+
+  FOR(g, n_groups) {
+    // the tail guarantees this much for a well formed stream, so the
+    // groups can read without checking
+    if (end - data < BYTE_GROUP_READ) return NULL;
+    int bits_log2 = (header[g / 4] >> (g % 4 * 2)) & 3;
+#if defined(SIMD_DISPATCH)
+    if (group_simd && (bits_log2 == 1 || bits_log2 == 2)) {
+      data = decodeByteGroupSimd(data, out + g * BYTE_GROUP, bits_log2);
+      continue;
+    }
+#endif
+    data = decodeByteGroup(data, out + g * BYTE_GROUP, bits_log2);
+  }
+  return data;
+}
+
+// === attributes ===
+
+static inline uint8_t unzigzag8(uint8_t v) { return -(v & 1) ^ (v >> 1); }
+
+#if defined(__SSE2__)
+static inline __m128i unzigzag8x16(__m128i v) {
+  __m128i odd  = _mm_sub_epi8(
+      _mm_setzero_si128(), _mm_and_si128(v, _mm_set1_epi8(1))
+  );
+  __m128i half = _mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi8(0x7f));
+  return _mm_xor_si128(half, odd);
+}
+#endif
+
+/// sums the deltas of 4 channels over `n` vertices into `out`, starting
+/// from the 4 bytes of `last`. `deltas` is padded to BYTE_GROUP.
+static void decodeDeltas(
+    uint8_t deltas[4][VERTEX_BLOCK_MAX], int n, uint8_t* out, int stride,
+    const uint8_t last[4]
+) {
+#if defined(__SSE2__)
+  int32_t base;
+  memcpy(&base, last, sizeof(base));
+  __m128i prev = _mm_set1_epi32(base);
+  for (int i = 0; i < n; i += BYTE_GROUP) {
+    // transpose 16 vertices of the 4 channels into 4 bytes per vertex
+    __m128i r[4];
+    FOR(c, 4) r[c] = _mm_loadu_si128((const __m128i*)&deltas[c][i]);
+    __m128i t0 = _mm_unpacklo_epi8(r[0], r[1]);
+    __m128i t1 = _mm_unpackhi_epi8(r[0], r[1]);
+    __m128i t2 = _mm_unpacklo_epi8(r[2], r[3]);
+    __m128i t3 = _mm_unpackhi_epi8(r[2], r[3]);
+
+    __m128i v[4] = {
+        _mm_unpacklo_epi16(t0, t2),
+        _mm_unpackhi_epi16(t0, t2),
+        _mm_unpacklo_epi16(t1, t3),
+        _mm_unpackhi_epi16(t1, t3),
+    };
+    FOR(j, 4) {
+      // prefix sum over the 4 vertices, bytes wrap independently
+      __m128i x = unzigzag8x16(v[j]);
+      x         = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+      x         = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+      x         = _mm_add_epi8(x, prev);
+      prev      = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+      FOR(k, 4) {
+        int vi = i + j * 4 + k;
+        if (vi >= n) return;
+        int32_t bytes = _mm_cvtsi128_si32(x);
+        memcpy(&out[vi * stride], &bytes, sizeof(bytes));
+        x = _mm_srli_si128(x, 4);
+      }
+    }
+  }
+#else
+  FOR(c, 4) {
+    uint8_t p = last[c];
+    FOR(vi, n) {
+      p += unzigzag8(deltas[c][vi]);
+      out[vi * stride + c] = p;
+    }
+  }
+#endif
+}
+
+/// one block of `n` vertices, `last` is the vertex before it
+static const uint8_t* decodeVertexBlock(
+    const uint8_t* data, const uint8_t* end, uint8_t* out, int n,
+    int stride, uint8_t last[256]
+) {
+  uint8_t deltas[4][VERTEX_BLOCK_MAX];
+  int n_aligned = (n + BYTE_GROUP - 1) & ~(BYTE_GROUP - 1);
+  // every byte of the vertex is a stream of its own, the vertex stride is
+  // a multiple of 4 so they are summed in fours
+  for (int k = 0; k < stride; k += 4) {
+    FOR(c, 4) {
+      data = decodeByteStream(data, end, deltas[c], n_aligned);
+      if (!data) return NULL;
+    }
+    decodeDeltas(deltas, n, out + k, stride, last + k);
+  }
+  memcpy(last, out + (n - 1) * stride, stride);
+  return data;
+}
+
+bool decodeMeshoptVertices(
+    void* dst, size_t count, size_t stride, const uint8_t* src, size_t size
+) {
+  if (stride == 0 || stride > 256 || stride % 4) return false;
+  if (size < 1 + stride || (src[0] & 0xf0) != VERTEX_HEADER ||
+      (src[0] & 0x0f) != 0)
+    return false;
+#if defined(SIMD_DISPATCH)
+  pthread_once(&group_tables_once, buildGroupTables);
+#endif
+
+  const uint8_t* end  = src + size;
+  const uint8_t* data = src + 1;
+  uint8_t last[256];
+  memcpy(last, end - stride, stride);
+
+  // blocks fit VERTEX_BLOCK_BYTES, in whole byte groups
+  size_t block = (VERTEX_BLOCK_BYTES / stride) & ~(size_t)(BYTE_GROUP - 1);
+  if (block > VERTEX_BLOCK_MAX) block = VERTEX_BLOCK_MAX;
+  for (size_t v = 0; v < count; v += block) {
+    size_t n = count - v < block ? count - v : block;
+    data     = decodeVertexBlock(
+        data, end, (uint8_t*)dst + v * stride, n, stride, last
+    );
+    if (!data) return false;
+  }
+  size_t tail = stride < VERTEX_TAIL_MIN ? VERTEX_TAIL_MIN : stride;
+  return (size_t)(end - data) == tail;
+}
+
+// === indices ===
+
+/// reads a little endian base 128 varint of at most 5 bytes
+static uint32_t readVarint(const uint8_t** data) {
+  const uint8_t* p = *data;
+  uint32_t v       = 0;
+  FOR(i, 5) {
+    uint8_t byte = *p++;
+    v |= (uint32_t)(byte & 127) << (7 * i);
+    if (byte < 128) break;
+  }
+  *data = p;
+  return v;
+}
+
+/// `last` plus a zigzag coded delta
+static uint32_t readIndexDelta(const uint8_t** data, uint32_t last) {
+  uint32_t v = readVarint(data);
+  return last + ((v >> 1) ^ -(v & 1));
+}
+
+static void writeIndex(void* dst, size_t i, size_t index_size, uint32_t v) {
+  if (index_size == 2) ((uint16_t*)dst)[i] = (uint16_t)v;
+  else ((uint32_t*)dst)[i] = v;
+}
+
+typedef struct {
+  uint32_t edges[16][2];
+  uint32_t vertices[16];
+  int next_edge;
+  int next_vertex;
+} IndexFifos;
+
+static void pushEdge(IndexFifos* f, uint32_t a, uint32_t b) {
+  f->edges[f->next_edge][0] = a;
+  f->edges[f->next_edge][1] = b;
+  f->next_edge              = (f->next_edge + 1) & 15;
+}
+
+static void pushVertex(IndexFifos* f, uint32_t v, bool push) {
+  f->vertices[f->next_vertex] = v;
+  f->next_vertex              = (f->next_vertex + push) & 15;
+}
+
+bool decodeMeshoptTriangles(
+    void* dst, size_t count, size_t index_size, const uint8_t* src,
+    size_t size
+) {
+  if (count % 3 || (index_size != 2 && index_size != 4)) return false;
+  // a header, a code per triangle and the auxiliary table at the end
+  if (size < 1 + count / 3 + 16 || (src[0] & 0xf0) != TRIANGLE_HEADER)
+    return false;
+  int version = src[0] & 0x0f;
+  if (version > 1) return false;
+
+  IndexFifos f;
+  memset(&f, 0xff, sizeof(f));
+  f.next_edge   = 0;
+  f.next_vertex = 0;
+  uint32_t next = 0; // the next new vertex
+  uint32_t last = 0; // the last free index
+  // version 1 codes last - 1 and last + 1 as 13 and 14
+  int fifo_max = version >= 1 ? 13 : 15;
+
+  const uint8_t* code     = src + 1;
+  const uint8_t* data     = code + count / 3;
+  const uint8_t* data_end = src + size - 16;
+  const uint8_t* aux      = data_end;
+
+  for (size_t i = 0; i < count; i += 3) {
+    // a triangle reads at most 16 bytes, which the table covers
+    if (data > data_end) return false;
+    uint8_t tri = *code++;
+    uint32_t a, b, c;
+
+    if (tri < 0xf0) {
+      // an edge from the fifo and a new, recent or free vertex
+      int fe = tri >> 4;
+      int fc = tri & 15;
+      a      = f.edges[(f.next_edge - 1 - fe) & 15][0];
+      b      = f.edges[(f.next_edge - 1 - fe) & 15][1];
+
+      bool is_new = fc == 0;
+      if (fc < fifo_max) {
+        c = is_new ? next++ : f.vertices[(f.next_vertex - 1 - fc) & 15];
+      } else if (fc != 15) {
+        // 13 and 14 decode to -1 and 1
+        last = c = last + (fc - (fc ^ 3));
+        is_new   = true;
+      } else {
+        last = c = readIndexDelta(&data, last);
+        is_new   = true;
+      }
+      pushVertex(&f, c, is_new);
+      pushEdge(&f, c, b);
+      pushEdge(&f, a, c);
+    } else {
+      // three vertices without a shared edge. The common combinations
+      // are in the table, the others in a byte of their own.
+      uint8_t codeaux;
+      int fa = 0;
+      if (tri < 0xfe) {
+        codeaux = aux[tri & 15];
+      } else {
+        codeaux = *data++;
+        fa      = tri == 0xfe ? 0 : 15;
+        // a restart of the new vertices
+        if (codeaux == 0) next = 0;
+      }
+      int fb = codeaux >> 4;
+      int fc = codeaux & 15;
+      a      = fa == 0 ? next++ : 0;
+      b      = fb == 0 ? next++ : f.vertices[(f.next_vertex - fb) & 15];
+      c      = fc == 0 ? next++ : f.vertices[(f.next_vertex - fc) & 15];
+      if (fa == 15) last = a = readIndexDelta(&data, last);
+      if (fb == 15) last = b = readIndexDelta(&data, last);
+      if (fc == 15) last = c = readIndexDelta(&data, last);
+      pushVertex(&f, a, true);
+      pushVertex(&f, b, fb == 0 || fb == 15);
+      pushVertex(&f, c, fc == 0 || fc == 15);
+      pushEdge(&f, b, a);
+      pushEdge(&f, c, b);
+      pushEdge(&f, a, c);
+    }
+    writeIndex(dst, i + 0, index_size, a);
+    writeIndex(dst, i + 1, index_size, b);
+    writeIndex(dst, i + 2, index_size, c);
+  }
+  return data == data_end;
+}
+
+bool decodeMeshoptIndices(
+    void* dst, size_t count, size_t index_size, const uint8_t* src,
+    size_t size
+) {
+  if (index_size != 2 && index_size != 4) return false;
+  // a header, a byte per index and a tail of 4
+  if (size < 1 + count + 4 || (src[0] & 0xf0) != SEQUENCE_HEADER ||
+      (src[0] & 0x0f) > 1)
+    return false;
+
+  const uint8_t* data     = src + 1;
+  const uint8_t* data_end = src + size - 4;
+  uint32_t last[2]        = {0, 0};
+  for (size_t i = 0; i < count; i++) {
+    // an index reads at most 5 bytes, which the tail covers
+    if (data >= data_end) return false;
+    // the low bit picks one of two baselines
+    uint32_t v   = readVarint(&data);
+    int baseline = v & 1;
+    v >>= 1;
+    last[baseline] += (v >> 1) ^ -(v & 1);
+    writeIndex(dst, i, index_size, last[baseline]);
+  }
+  return data == data_end;
+}
+
+// === filters ===
+
+static inline int roundSigned(float v) {
+  return (int)(v + (v >= 0.0f ? 0.5f : -0.5f));
+}
+
+/// unit vector from octahedral x, y and the scale in z, rescaled to `max`
+static void octahedral(float x, float y, float z, float max, int out[3]) {
+  z -= fabsf(x) + fabsf(y);
+  // unfold the lower half
+  float t = z < 0.0f ? z : 0.0f;
+  x += x >= 0.0f ? t : -t;
+  y += y >= 0.0f ? t : -t;
+  float s = max / sqrtf(x * x + y * y + z * z);
+  out[0]  = roundSigned(x * s);
+  out[1]  = roundSigned(y * s);
+  out[2]  = roundSigned(z * s);
+}
+
+void meshoptFilterOctahedral(void* data, size_t count, size_t stride) {
+  if (stride == 4) {
+    int8_t* v = data;
+    for (size_t i = 0; i < count; i++, v += 4) {
+      int n[3];
+      octahedral(v[0], v[1], v[2], 127.0f, n);
+      FOR(c, 3) v[c] = (int8_t)n[c];
+    }
+    return;
+  }
+  if (stride != 8) return;
+
+  int16_t* v = data;
+  size_t i   = 0;
+#if defined(__SSE2__)
+  const __m128 max  = _mm_set1_ps(32767.0f);
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  for (; i + 4 <= count; i += 4, v += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)&v[0]);
+    __m128i b = _mm_loadu_si128((const __m128i*)&v[8]);
+    // sign extend the even (x, z) and odd (y, w) components
+    __m128 xz_a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16));
+    __m128 xz_b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+    __m128 yw_a = _mm_cvtepi32_ps(_mm_srai_epi32(a, 16));
+    __m128 yw_b = _mm_cvtepi32_ps(_mm_srai_epi32(b, 16));
+    __m128 x    = _mm_shuffle_ps(xz_a, xz_b, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 z    = _mm_shuffle_ps(xz_a, xz_b, _MM_SHUFFLE(3, 1, 3, 1));
+    __m128 y    = _mm_shuffle_ps(yw_a, yw_b, _MM_SHUFFLE(2, 0, 2, 0));
+
+    __m128 ax = _mm_andnot_ps(sign, x);
+    __m128 ay = _mm_andnot_ps(sign, y);
+    z         = _mm_sub_ps(z, _mm_add_ps(ax, ay));
+    // t = min(z, 0), added to x and y with their sign
+    __m128 t = _mm_min_ps(z, _mm_setzero_ps());
+    x        = _mm_add_ps(x, _mm_xor_ps(t, _mm_and_ps(x, sign)));
+    y        = _mm_add_ps(y, _mm_xor_ps(t, _mm_and_ps(y, sign)));
+
+    __m128 len2 = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)
+    );
+    __m128 s = _mm_div_ps(max, _mm_sqrt_ps(len2));
+    // round half away from zero
+    __m128i xi = _mm_cvttps_epi32(_mm_add_ps(
+        _mm_mul_ps(x, s), _mm_or_ps(half, _mm_and_ps(x, sign))
+    ));
+    __m128i yi = _mm_cvttps_epi32(_mm_add_ps(
+        _mm_mul_ps(y, s), _mm_or_ps(half, _mm_and_ps(y, sign))
+    ));
+    __m128i zi = _mm_cvttps_epi32(_mm_add_ps(
+        _mm_mul_ps(z, s), _mm_or_ps(half, _mm_and_ps(z, sign))
+    ));
+
+    // repack as x y z w, keeping w
+    __m128 zw_ab = _mm_shuffle_ps(
+        _mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)
+    );
+    __m128i w   = _mm_castps_si128(zw_ab);
+    __m128i low = _mm_set1_epi32(0xffff);
+    __m128i xy  = _mm_or_si128(_mm_and_si128(xi, low), _mm_slli_epi32(yi, 16));
+    __m128i zw  = _mm_or_si128(
+        _mm_and_si128(zi, low), _mm_andnot_si128(low, w)
+    );
+    _mm_storeu_si128((__m128i*)&v[0], _mm_unpacklo_epi32(xy, zw));
+    _mm_storeu_si128((__m128i*)&v[8], _mm_unpackhi_epi32(xy, zw));
+  }
+#endif
+  for (; i < count; i++, v += 4) {
+    int n[3];
+    octahedral(v[0], v[1], v[2], 32767.0f, n);
+    FOR(c, 3) v[c] = (int16_t)n[c];
+  }
+}
+
+void meshoptFilterQuaternion(void* data, size_t count, size_t stride) {
+  if (stride != 8) return;
+  int16_t* q = data;
+  for (size_t i = 0; i < count; i++, q += 4) {
+    // the low 2 bits of w name the dropped (largest) component, the rest
+    // scales the other three
+    int scale = q[3] | 3;
+    float s   = 1.0f / sqrtf(2.0f) / scale;
+    float x   = q[0] * s;
+    float y   = q[1] * s;
+    float z   = q[2] * s;
+    float ww  = 1.0f - x * x - y * y - z * z;
+    float w   = sqrtf(ww >= 0.0f ? ww : 0.0f);
+
+    int dropped    = q[3] & 3;
+    int16_t out[4] = {0};
+
+    out[(dropped + 1) & 3] = (int16_t)roundSigned(x * 32767.0f);
+    out[(dropped + 2) & 3] = (int16_t)roundSigned(y * 32767.0f);
+    out[(dropped + 3) & 3] = (int16_t)roundSigned(z * 32767.0f);
+    out[dropped]           = (int16_t)roundSigned(w * 32767.0f);
+    memcpy(q, out, sizeof(out));
+  }
+}
+
+void meshoptFilterExponential(void* data, size_t count, size_t stride) {
+  if (stride % 4) return;
+  uint32_t* v = data;
+  size_t n    = count * stride / 4;
+  size_t i    = 0;
+  // a 24 bit signed mantissa and an 8 bit signed exponent, the float is
+  // built from 2^e times the mantissa
+#if defined(__SSE2__)
+  for (; i + 4 <= n; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*)&v[i]);
+    __m128i m = _mm_srai_epi32(_mm_slli_epi32(x, 8), 8);
+    __m128i e = _mm_srai_epi32(x, 24);
+    __m128 p  = _mm_castsi128_ps(
+        _mm_slli_epi32(_mm_add_epi32(e, _mm_set1_epi32(127)), 23)
+    );
+    __m128 f = _mm_mul_ps(p, _mm_cvtepi32_ps(m));
+    _mm_storeu_si128((__m128i*)&v[i], _mm_castps_si128(f));
+  }
+#endif
+  for (; i < n; i++) {
+    int32_t m     = (int32_t)(v[i] << 8) >> 8;
+    int32_t e     = (int32_t)v[i] >> 24;
+    uint32_t bits = (uint32_t)(e + 127) << 23;
+    float p, f;
+    memcpy(&p, &bits, sizeof(p));
+    f = p * (float)m;
+    memcpy(&v[i], &f, sizeof(f));
+  }
+}
+
+// === buffer views ===
+
+bool decodeMeshoptView(cgltf_buffer_view* view) {
+  const cgltf_meshopt_compression* mc = &view->meshopt_compression;
+  const cgltf_buffer* buffer          = mc->buffer;
+  if (!buffer || !buffer->data || mc->offset + mc->size > buffer->size)
+    return false;
+  const uint8_t* src = (const uint8_t*)buffer->data + mc->offset;
+
+  // allocated like cgltf does, so cgltf_free can release it
+  size_t size = mc->count * mc->stride;
+  void* dst   = malloc(size ? size : 1);
+  if (!dst) return false;
+  view->data = dst;
+
+  bool ok = false;
+  switch (mc->mode) {
+  case cgltf_meshopt_compression_mode_attributes:
+    ok = decodeMeshoptVertices(dst, mc->count, mc->stride, src, mc->size);
+    break;
+  case cgltf_meshopt_compression_mode_triangles:
+    ok = decodeMeshoptTriangles(dst, mc->count, mc->stride, src, mc->size);
+    break;
+  case cgltf_meshopt_compression_mode_indices:
+    ok = decodeMeshoptIndices(dst, mc->count, mc->stride, src, mc->size);
+    break;
+  default: break;
+  }
+  if (!ok) return false;
+
+  switch (mc->filter) {
+  case cgltf_meshopt_compression_filter_octahedral:
+    meshoptFilterOctahedral(dst, mc->count, mc->stride);
+    break;
+  case cgltf_meshopt_compression_filter_quaternion:
+    meshoptFilterQuaternion(dst, mc->count, mc->stride);
+    break;
+  case cgltf_meshopt_compression_filter_exponential:
+    meshoptFilterExponential(dst, mc->count, mc->stride);
+    break;
+  default: break;
+  }
+  return true;
+}
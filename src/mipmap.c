@@ -0,0 +1,140 @@
+#include "textures/mipmap.h"
+#include "thread_pool.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// resolution of the linear -> srgb table, fine enough that the darkest
+// steps of the curve still land on the right byte
+#define ENCODE_TABLE_SIZE 4096
+// rows of a level filtered by one task
+#define BAND_ROWS 32
+
+static float SRGB_TO_LINEAR[256];
+static float UNORM_TO_FLOAT[256];
+static uint8_t LINEAR_TO_SRGB[ENCODE_TABLE_SIZE + 1];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void initSrgbTables(void) {
+  FOR(i, 256) {
+    float c           = i / 255.0f;
+    UNORM_TO_FLOAT[i] = c;
+    SRGB_TO_LINEAR[i] =
+        c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+  }
+  FOR(i, ENCODE_TABLE_SIZE + 1) {
+    float l = (float)i / ENCODE_TABLE_SIZE;
+    float c =
+        l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+    LINEAR_TO_SRGB[i] = (uint8_t)lrintf(c * 255.0f);
+  }
+}
+
+int mipLevelCount(int w, int h) {
+  int n = 1;
+  for (int size = w > h ? w : h; size > 1; size /= 2) n++;
+  return n < MAX_MIP_LEVELS ? n : MAX_MIP_LEVELS;
+}
+
+int mipSize(int size, int level) {
+  size >>= level;
+  return size > 0 ? size : 1;
+}
+
+typedef struct {
+  const ImageData* src;
+  ImageData* dst;
+  bool srgb;
+  int first_row;
+  int n_rows;
+} MipBandTask;
+
+static void downsampleBandTask(void* arg) {
+  MipBandTask* task    = arg;
+  const ImageData* src = task->src;
+  ImageData* dst       = task->dst;
+  int n_ch             = src->format + 1;
+  // the color channels, alpha is never srgb encoded
+  int n_color = n_ch == 2 || n_ch == 4 ? n_ch - 1 : n_ch;
+  const float* decode[4];
+  FOR(k, 4) {
+    decode[k] = task->srgb && k < n_color ? SRGB_TO_LINEAR : UNORM_TO_FLOAT;
+  }
+
+  for (int y = task->first_row; y < task->first_row + task->n_rows; y++) {
+    // odd sizes drop their last row / column, like the gl implementations
+    int y1            = 2 * y + 1 < src->h ? 2 * y + 1 : src->h - 1;
+    const uint8_t* r0 = &src->data[(size_t)2 * y * src->w * n_ch];
+    const uint8_t* r1 = &src->data[(size_t)y1 * src->w * n_ch];
+    uint8_t* out      = &dst->data[(size_t)y * dst->w * n_ch];
+    FOR(x, dst->w) {
+      int x0 = 2 * x * n_ch;
+      int x1 = (2 * x + 1 < src->w ? 2 * x + 1 : src->w - 1) * n_ch;
+
+      // the four samples in linear space, one lane per channel
+      float sum[4] = {0};
+      FOR(k, n_ch) {
+        const float* t = decode[k];
+        sum[k] = t[r0[x0 + k]] + t[r0[x1 + k]] + t[r1[x0 + k]] + t[r1[x1 + k]];
+      }
+      FOR(k, n_ch) {
+        float v = sum[k] * 0.25f;
+        out[x * n_ch + k] =
+            decode[k] == SRGB_TO_LINEAR
+                ? LINEAR_TO_SRGB[lrintf(v * ENCODE_TABLE_SIZE)]
+                : (uint8_t)lrintf(v * 255.0f);
+      }
+    }
+  }
+}
+
+bool buildMipChain(const ImageData* base, bool srgb, MipChain* chain) {
+  pthread_once(&tables_once, initSrgbTables);
+  *chain           = (MipChain){0};
+  chain->n_levels  = mipLevelCount(base->w, base->h);
+  chain->levels[0] = *base;
+
+  // all smaller levels share one allocation
+  int n_ch     = base->format + 1;
+  size_t total = 0;
+  for (int l = 1; l < chain->n_levels; l++)
+    total += (size_t)mipSize(base->w, l) * mipSize(base->h, l) * n_ch;
+  chain->storage = total ? malloc(total) : NULL;
+  if (total && !chain->storage) return false;
+
+  int n_tasks        = (mipSize(base->h, 1) + BAND_ROWS - 1) / BAND_ROWS;
+  MipBandTask* tasks = malloc(n_tasks * sizeof(MipBandTask));
+  if (!tasks) {
+    freeMipChain(chain);
+    return false;
+  }
+  ThreadPool* pool = sharedThreadPool();
+  TaskGroup group  = {0};
+
+  // every level depends on the previous one, only its rows are parallel
+  unsigned char* next = chain->storage;
+  for (int l = 1; l < chain->n_levels; l++) {
+    ImageData* level = &chain->levels[l];
+    level->w         = mipSize(base->w, l);
+    level->h         = mipSize(base->h, l);
+    level->format    = base->format;
+    level->data      = next;
+    next += (size_t)level->w * level->h * n_ch;
+
+    int n = 0;
+    for (int y = 0; y < level->h; y += BAND_ROWS, n++) {
+      int rows = level->h - y < BAND_ROWS ? level->h - y : BAND_ROWS;
+      tasks[n] = (MipBandTask){&chain->levels[l - 1], level, srgb, y, rows};
+      submitTask(pool, &group, downsampleBandTask, &tasks[n]);
+    }
+    waitTaskGroup(pool, &group);
+  }
+  free(tasks);
+  return true;
+}
+
+void freeMipChain(MipChain* chain) {
+  free(chain->storage);
+  *chain = (MipChain){0};
+}
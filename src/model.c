@@ -1,79 +1,575 @@
 
+#define _DEFAULT_SOURCE
 #include <cglm/cglm.h>
 #include <cglm/mat4.h>
 #include <cgltf/cgltf.h>
 #define CGLTF_IMPLEMENTATION
+#define ARENA_IMPLEMENTATION
 #include "models/model.h"
+#include "models/bounds.h"
+#include "models/lod.h"
+#include "models/mesh_cache.h"
+#include "models/mesh_optimize.h"
+#include "models/meshlet.h"
+#include "models/meshopt_decode.h"
+#include "models/quantize.h"
+#include "models/tangents.h"
+#include "log.h"
+#include "thread_pool.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <cglm/cglm.h>
 #include "external/stb_image.h"
 
 int format_to_gl_const(ImageFormat format) {
   switch (format) {
-  case GRAY: return GL_LUMINANCE;
-  case GRAY_ALPHA: return GL_LUMINANCE_ALPHA;
+  // core profiles have no luminance formats, these are swizzled on upload
+  case GRAY: return GL_RED;
+  case GRAY_ALPHA: return GL_RG;
   case RED_GREEN_BLUE: return GL_RGB;
   case RED_GEEN_BLUE_ALPHA: return GL_RGBA;
   default: return -1;
   }
 }
 
-/// helping macro that takes the information provided by the accessor
-/// and copies the data to a destination buffer
-#define LOAD_ATTRIBUTE(accessor, numComp, dataType, dstPtr)                    \
-  {                                                                            \
-    int _n            = 0;                                                     \
-    dataType* _buffer = (dataType*)accessor->buffer_view->buffer->data +       \
-                        accessor->buffer_view->offset / sizeof(dataType) +     \
-                        accessor->offset / sizeof(dataType);                   \
-    for (unsigned int k = 0; k < accessor->count; k++) {                       \
-      for (int l = 0; l < numComp; l++) {                                      \
-        dstPtr[numComp * k + l] = _buffer[_n + l];                             \
-      }                                                                        \
-      _n += (int)(accessor->stride / sizeof(dataType));                        \
-    }                                                                          \
+int index_type_to_gl_const(IndexType type) {
+  switch (type) {
+  case INDEX_U8: return GL_UNSIGNED_BYTE;
+  case INDEX_U16: return GL_UNSIGNED_SHORT;
+  case INDEX_U32: return GL_UNSIGNED_INT;
+  default: return -1;
+  }
+}
+
+int indexSize(IndexType type) {
+  switch (type) {
+  case INDEX_U8: return 1;
+  case INDEX_U16: return 2;
+  default: return 4;
+  }
+}
+
+int component_type_to_gl_const(ComponentType type) {
+  switch (type) {
+  case COMPONENT_F32: return GL_FLOAT;
+  case COMPONENT_I8: return GL_BYTE;
+  case COMPONENT_U8: return GL_UNSIGNED_BYTE;
+  case COMPONENT_I16: return GL_SHORT;
+  case COMPONENT_U16: return GL_UNSIGNED_SHORT;
+  default: return -1;
+  }
+}
+
+int componentSize(ComponentType type) {
+  switch (type) {
+  case COMPONENT_I8:
+  case COMPONENT_U8: return 1;
+  case COMPONENT_I16:
+  case COMPONENT_U16: return 2;
+  default: return 4;
+  }
+}
+
+// components per vertex of the attributes of a `Mesh`, in its order
+static const int ATTRIBUTE_COMPONENTS[N_MESH_ATTRIBUTES] = {3, 3, 4, 2};
+
+const void* meshAttribute(const Mesh* m, int k) {
+  if (m->formats[k].type != COMPONENT_F32) return m->encoded[k];
+  switch (k) {
+  case 0: return m->vertices;
+  case 1: return m->normals;
+  case 2: return m->tangents;
+  default: return m->tex_coords;
+  }
+}
+
+int meshAttributeStride(const Mesh* m, int k) {
+  int size = ATTRIBUTE_COMPONENTS[k] * componentSize(m->formats[k].type);
+  return (size + 3) & ~3;
+}
+
+IndexType narrowIndexType(int n_vertices) {
+  // u8 indices are emulated by many drivers, so we never narrow to them
+  return n_vertices <= UINT16_MAX + 1 ? INDEX_U16 : INDEX_U32;
+}
+
+void copyIndices(
+    void* dst, IndexType dst_type, const void* src, IndexType src_type, int n
+) {
+  if (dst_type == src_type) {
+    memmove(dst, src, (size_t)n * indexSize(src_type));
+    return;
+  }
+  FOR(i, n) {
+    uint32_t index;
+    switch (src_type) {
+    case INDEX_U8: index = ((const uint8_t*)src)[i]; break;
+    case INDEX_U16: index = ((const uint16_t*)src)[i]; break;
+    default: index = ((const uint32_t*)src)[i]; break;
+    }
+    switch (dst_type) {
+    case INDEX_U8: ((uint8_t*)dst)[i] = index; break;
+    case INDEX_U16: ((uint16_t*)dst)[i] = index; break;
+    default: ((uint32_t*)dst)[i] = index; break;
+    }
   }
+}
+
+// split the meshes into meshlets for cluster culling, see models/meshlet.h
+#define BUILD_MESHLETS true
+
+/// the bytes of a float accessor when they are tightly packed in its
+/// buffer, such that they can be copied as a whole. NULL if the accessor
+/// has to be unpacked element by element.
+static const void* packedFloats(const cgltf_accessor* accessor) {
+  if (accessor->is_sparse || accessor->normalized ||
+      accessor->component_type != cgltf_component_type_r_32f ||
+      !accessor->buffer_view)
+    return NULL;
+  cgltf_size size = cgltf_calc_size(accessor->type, accessor->component_type);
+  if (accessor->stride != size) return NULL;
+  const uint8_t* data = cgltf_buffer_view_data(accessor->buffer_view);
+  return data ? data + accessor->offset : NULL;
+}
 
 /// macro for reducing the amount of visual clutter
 /// NOTE: this macro is NOT hygienic
-#define IS_PRIMITIVE(attr, accr, comp)                                         \
+#define IS_PRIMITIVE(attr, accr)                                               \
   ((attribute_type == cgltf_attribute_type_##attr) &&                          \
-   (accessor_type == cgltf_type_##accr) &&                                     \
-   (component_type == cgltf_component_type_##comp))
+   (accessor_type == cgltf_type_##accr))
+
+// in the order of `ImportData`
+typedef enum {
+  ATTRIBUTE_POSITION,
+  ATTRIBUTE_NORMAL,
+  ATTRIBUTE_TANGENT,
+  ATTRIBUTE_TEXCOORD,
+} AttributeKind;
+
+/// how an attribute of `kind` is stored, false when it is neither float
+/// nor one of the KHR_mesh_quantization encodings allowed for `kind`
+static bool attributeFormat(
+    const cgltf_accessor* accessor, AttributeKind kind, AttributeFormat* f
+) {
+  f->normalized = accessor->normalized;
+  switch (accessor->component_type) {
+  case cgltf_component_type_r_32f: f->type = COMPONENT_F32; break;
+  case cgltf_component_type_r_8: f->type = COMPONENT_I8; break;
+  case cgltf_component_type_r_8u: f->type = COMPONENT_U8; break;
+  case cgltf_component_type_r_16: f->type = COMPONENT_I16; break;
+  case cgltf_component_type_r_16u: f->type = COMPONENT_U16; break;
+  default: return false;
+  }
+  if (f->type == COMPONENT_F32) return !f->normalized;
+  bool is_signed = f->type == COMPONENT_I8 || f->type == COMPONENT_I16;
+  switch (kind) {
+  // the node transform scales integer positions back
+  case ATTRIBUTE_POSITION: return true;
+  // integer texture coordinates rely on KHR_texture_transform, which is
+  // not supported, so only normalized ones map onto the texture
+  case ATTRIBUTE_TEXCOORD: return f->normalized;
+  // directions are normalized signed integers
+  default: return f->normalized && is_signed;
+  }
+}
+
+// the loader is split into independent tasks that are run on the shared
+// thread pool. Every task writes to its own slot in the `Model`, so the
+// result does not depend on the order in which they are executed.
+
+// all storage of the model is allocated from its arena on the main thread
+// while queueing, the tasks only fill it. The arena is not thread safe.
+
+/// decodes one EXT_meshopt_compression buffer view
+typedef struct {
+  cgltf_buffer_view* view;
+  bool ok;
+  ClockReading begin, end;
+} MeshoptTask;
+
+/// decodes one image of the file, materials that share it share the result
+typedef struct {
+  const unsigned char* bytes; // the encoded image, NULL when not queued
+  cgltf_size size;
+  unsigned char* pixels; // room for the decoded image
+  size_t pixels_size;
+  ImageData image;
+  ClockReading begin, end;
+} ImageTask;
+
+/// unpacks one attribute of a primitive, in the space of its mesh
+typedef struct {
+  cgltf_accessor* accessor;
+  AttributeKind kind;
+  float* data; // room for the unpacked attribute
+  Mesh* mesh;  // set when the positions have to be scanned for the bounds
+  ClockReading begin, end;
+} AttributeTask;
+
+/// unpacks (and narrows) the indices of a primitive
+typedef struct {
+  cgltf_accessor* accessor;
+  Mesh* mesh;
+  ClockReading begin, end;
+} IndexTask;
+
+/// reorders a mesh once its attributes and indices are loaded, and builds
+/// its levels of detail and meshlets from the result
+typedef struct {
+  Mesh* mesh;
+  MeshOptStats stats;
+  Arena arena; // merged into the model arena once the task is done
+  ClockReading begin, end;
+} OptimizeTask;
+
+void* arenaAllocAligned(Arena* a, size_t size, size_t align) {
+  // the arena hands out word aligned memory, pad for anything larger
+  size_t pad  = align > sizeof(uintptr_t) ? align - sizeof(uintptr_t) : 0;
+  uintptr_t p = (uintptr_t)arena_alloc(a, size + pad);
+  return (void*)((p + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+void* arenaCalloc(Arena* a, size_t n, size_t size) {
+  return memset(arena_alloc(a, n * size), 0, n * size);
+}
+
+/// moves the regions of `src` to the end of `dst`
+static void arenaMerge(Arena* dst, Arena* src) {
+  if (!src->begin) return;
+  if (!dst->begin) {
+    *dst = *src;
+  } else {
+    Region* last = dst->end;
+    while (last->next) last = last->next;
+    last->next = src->begin;
+  }
+  *src = (Arena){0};
+}
+
+static float** attributeField(Mesh* mesh, AttributeKind kind) {
+  switch (kind) {
+  case ATTRIBUTE_POSITION: return &mesh->vertices;
+  case ATTRIBUTE_NORMAL: return &mesh->normals;
+  case ATTRIBUTE_TANGENT: return &mesh->tangents;
+  default: return &mesh->tex_coords;
+  }
+}
+
+static void decodeMeshoptTask(void* arg) {
+  MeshoptTask* task = arg;
+  task->begin       = readClock();
+  task->ok          = decodeMeshoptView(task->view);
+  task->end         = readClock();
+}
+
+static void decodeImageTask(void* arg) {
+  ImageTask* task = arg;
+  task->begin     = readClock();
+
+  // stb_image allocates the decoded image itself, so it is copied over
+  ImageData image = {0};
+  int n_channels  = 0;
+  unsigned char* pixels = stbi_load_from_memory(
+      task->bytes, task->size, &image.w, &image.h, &n_channels, 0
+  );
+  size_t size = (size_t)image.w * image.h * n_channels;
+  if (pixels && size == task->pixels_size && 1 <= n_channels &&
+      n_channels <= N_IMAGE_FORMATS) {
+    image.format = n_channels - 1;
+    image.data   = task->pixels;
+    memcpy(image.data, pixels, size);
+    task->image = image;
+  }
+  stbi_image_free(pixels);
+  task->end = readClock();
+}
+
+static void unpackAttributeTask(void* arg) {
+  AttributeTask* task      = arg;
+  cgltf_accessor* accessor = task->accessor;
+  float* data              = task->data;
+  task->begin              = readClock();
+
+  // the accessor tells us how to extract the data from the gltf buffers,
+  // packed data is copied as is
+  cgltf_size n_floats =
+      accessor->count * cgltf_num_components(accessor->type);
+  const void* packed  = packedFloats(accessor);
+  if (packed) memcpy(data, packed, n_floats * sizeof(float));
+  else cgltf_accessor_unpack_floats(accessor, data, n_floats);
+  if (task->mesh) computeMeshBounds(task->mesh);
+  task->end = readClock();
+}
+
+static void unpackIndexTask(void* arg) {
+  IndexTask* task          = arg;
+  cgltf_accessor* accessor = task->accessor;
+  Mesh* mesh               = task->mesh;
+  task->begin              = readClock();
+
+  // the type was picked while queueing, and is never wider than the source
+  cgltf_size count = accessor->count;
+  int size         = indexSize(mesh->index_type);
+  if ((cgltf_size)size == cgltf_component_size(accessor->component_type)) {
+    cgltf_accessor_unpack_indices(accessor, mesh->indices, size, count);
+  } else {
+    // cgltf only widens, narrowing u32 to u16 is done here
+    uint16_t* dst = mesh->indices;
+    for (cgltf_size k = 0; k < count; k++)
+      dst[k] = (uint16_t)cgltf_accessor_read_index(accessor, k);
+  }
+  task->end = readClock();
+}
+
+/// encodes the attributes that were quantized in the file back to their
+/// file format, once nothing needs them as floats anymore. The floats are
+/// scratch memory and dropped from the mesh.
+static void encodeFileAttributes(Mesh* mesh, Arena* arena) {
+  FOR(k, N_MESH_ATTRIBUTES) {
+    float** field = attributeField(mesh, k);
+    if (!*field || mesh->formats[k].type == COMPONENT_F32) continue;
+    size_t size = (size_t)mesh->n_vertices * meshAttributeStride(mesh, k);
+    mesh->encoded[k] = arenaAllocAligned(arena, size, MODEL_ALIGNMENT);
+    encodeComponents(
+        *field,
+        mesh->n_vertices,
+        ATTRIBUTE_COMPONENTS[k],
+        mesh->formats[k],
+        mesh->encoded[k]
+    );
+    *field = NULL;
+  }
+}
+
+static void optimizeMeshTask(void* arg) {
+  OptimizeTask* task = arg;
+  task->begin        = readClock();
+  task->stats        = optimizeMesh(task->mesh);
+  generateMeshLods(task->mesh, &task->arena);
+  if (BUILD_MESHLETS) buildMeshlets(task->mesh, &task->arena);
+  encodeFileAttributes(task->mesh, &task->arena);
+  task->end = readClock();
+}
+
+/// the instances of an EXT_mesh_gpu_instancing node, 0 for other nodes
+static int gpuInstanceCount(const cgltf_node* node) {
+  const cgltf_mesh_gpu_instancing* ext = &node->mesh_gpu_instancing;
+  if (!node->has_mesh_gpu_instancing || !node->mesh ||
+      !ext->attributes_count)
+    return 0;
+  // the validator makes every attribute the same length
+  return ext->attributes[0].data->count;
+}
+
+/// the transforms of the `n` instances of `node`
+static void readGpuInstances(const cgltf_node* node, int n, float (*out)[16]) {
+  const cgltf_mesh_gpu_instancing* ext = &node->mesh_gpu_instancing;
+  const cgltf_accessor* translation    = NULL;
+  const cgltf_accessor* rotation       = NULL;
+  const cgltf_accessor* scale          = NULL;
+  for (cgltf_size ai = 0; ai < ext->attributes_count; ai++) {
+    const cgltf_attribute* attribute = &ext->attributes[ai];
+    if (!strcmp(attribute->name, "TRANSLATION")) translation = attribute->data;
+    else if (!strcmp(attribute->name, "ROTATION")) rotation = attribute->data;
+    else if (!strcmp(attribute->name, "SCALE")) scale = attribute->data;
+  }
+  FOR(k, n) {
+    // left out attributes are the identity, rotations may be normalized
+    // integers which cgltf converts
+    float t[3] = {0, 0, 0}, r[4] = {0, 0, 0, 1}, s[3] = {1, 1, 1};
+    if (translation) cgltf_accessor_read_float(translation, k, t, 3);
+    if (rotation) cgltf_accessor_read_float(rotation, k, r, 4);
+    if (scale) cgltf_accessor_read_float(scale, k, s, 3);
+    composeTransform(t, r, s, out[k]);
+  }
+}
+
+/// appends `node` and its subtree to `scene`, parents first
+static void addSceneNode(
+    Scene* scene, const cgltf_data* data, const cgltf_node* node, int parent,
+    const int* first_mesh, const int* n_meshes
+) {
+  if (scene->n_nodes == (int)data->nodes_count) return;
+  int index     = scene->n_nodes++;
+  SceneNode* s  = &scene->nodes[index];
+  s->parent     = parent;
+  s->first_mesh = -1;
+  if (node->mesh) {
+    cgltf_size mi = cgltf_mesh_index(data, node->mesh);
+    s->first_mesh = first_mesh[mi];
+    s->n_meshes   = n_meshes[mi];
+  }
+  cgltf_node_transform_local(node, s->local);
+  // room for the instances of every node was made up front
+  s->first_instance = scene->n_instance_transforms;
+  s->n_instances    = gpuInstanceCount(node);
+  readGpuInstances(
+      node, s->n_instances, &scene->instance_transforms[s->first_instance]
+  );
+  scene->n_instance_transforms += s->n_instances;
+  for (cgltf_size ci = 0; ci < node->children_count; ci++) {
+    addSceneNode(
+        scene, data, node->children[ci], index, first_mesh, n_meshes
+    );
+  }
+}
+
+/// maps `path` read only, NULL on failure
+static void* mapFile(const char* path, size_t* size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+  *size     = (size_t)st.st_size;
+  void* map = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  return map == MAP_FAILED ? NULL : map;
+}
 
 // NOTE: this function very closely mimics LoadGLTF from raylib
-LoadModelRes loadModelFromGltfFile(const char* path, Model* model) {
+LoadModelRes loadModelFromGltfFile(
+    const char* path, Model* model, ImportReport* report
+) {
+  ImportReport unused = {0};
+  if (!report) report = &unused;
+  ClockReading mark = readClock();
+
+  // the file is mapped rather than read. cgltf points the glb binary chunk
+  // into the mapping, so the buffers are never copied to the heap and the
+  // tasks read straight from the page cache.
+  size_t file_size = 0;
+  void* file       = mapFile(path, &file_size);
+  if (!file) return ERROR;
+  madvise(file, file_size, MADV_SEQUENTIAL);
+
   // load gltf file
   cgltf_options ops     = {0};
   cgltf_data* gltf_data = NULL;
-  cgltf_result gltf_err = cgltf_parse_file(&ops, path, &gltf_data) ||
-                          cgltf_validate(gltf_data) ||
-                          cgltf_load_buffers(&ops, gltf_data, path);
-  if (gltf_err) return ERROR;
+  cgltf_result gltf_err = cgltf_parse(&ops, file, file_size, &gltf_data);
+  mark = endPhase(report, PHASE_PARSE, mark);
+  if (!gltf_err) gltf_err = cgltf_validate(gltf_data);
+  mark = endPhase(report, PHASE_VALIDATE, mark);
+  if (!gltf_err) gltf_err = cgltf_load_buffers(&ops, gltf_data, path);
+  endPhase(report, PHASE_BUFFERS, mark);
 
   // check some simple constraints
-  if (gltf_data->scenes_count != 1 ||
-      gltf_data->file_type != cgltf_file_type_glb)
+  if (gltf_err || gltf_data->scenes_count != 1 ||
+      gltf_data->file_type != cgltf_file_type_glb) {
+    if (gltf_data) cgltf_free(gltf_data);
+    munmap(file, file_size);
+    return ERROR;
+  }
+
+  ThreadPool* pool = sharedThreadPool();
+  TaskGroup group  = {0};
+  Arena scratch    = {0};
+
+  // compressed buffer views are decoded before anything reads them, into
+  // `view->data` where cgltf looks first
+  int n_views = gltf_data->buffer_views_count;
+  MeshoptTask* meshopt_tasks =
+      arenaCalloc(&scratch, n_views, sizeof(*meshopt_tasks));
+  FOR(vi, n_views) {
+    cgltf_buffer_view* view = &gltf_data->buffer_views[vi];
+    if (!view->has_meshopt_compression) continue;
+    meshopt_tasks[vi].view = view;
+    submitTask(pool, &group, decodeMeshoptTask, &meshopt_tasks[vi]);
+  }
+  waitTaskGroup(pool, &group);
+  bool decoded = true;
+  FOR(vi, n_views) {
+    MeshoptTask* task = &meshopt_tasks[vi];
+    if (!task->view) continue;
+    addPhaseTime(&report->phases[PHASE_DECOMPRESS], task->begin, task->end);
+    if (!task->ok) {
+      LOG(LOG_LEVEL_ERROR, "> could not decode buffer view %d\n", vi);
+      decoded = false;
+    }
+  }
+  if (!decoded) {
+    arena_free(&scratch);
+    cgltf_free(gltf_data);
+    munmap(file, file_size);
     return ERROR;
+  }
+  mark = readClock();
 
   // we want to extract all meshes from the file and transform them
-  // into a format that is easier for us to manage.
-
-  // first we count the meshes them such that we can allocate enough space
-  int n_meshes = 0;
-  for (cgltf_size ni = 0; ni < gltf_data->nodes_count; ni++) {
-    cgltf_node* n = &(gltf_data->nodes[ni]);
-    cgltf_mesh* m = n->mesh;
-    if (!m) continue;
-    for (cgltf_size pi = 0; pi < n->mesh->primitives_count; pi++) {
-      if (m->primitives[pi].type == cgltf_primitive_type_triangles) n_meshes++;
+  // into a format that is easier for us to manage. Every gltf mesh is
+  // loaded once, in its own space, and placed by the nodes that use it.
+
+  // first we count the meshes and the work needed to load them,
+  // such that we can allocate enough space up front
+  int n_gltf_meshes    = gltf_data->meshes_count;
+  int* gltf_first_mesh = arenaCalloc(&scratch, n_gltf_meshes, sizeof(int));
+  int* gltf_n_meshes   = arenaCalloc(&scratch, n_gltf_meshes, sizeof(int));
+  int n_meshes         = 0;
+  int n_attributes     = 0;
+  FOR(gi, n_gltf_meshes) {
+    cgltf_mesh* m       = &gltf_data->meshes[gi];
+    gltf_first_mesh[gi] = n_meshes;
+    for (cgltf_size pi = 0; pi < m->primitives_count; pi++) {
+      if (m->primitives[pi].type != cgltf_primitive_type_triangles) continue;
+      gltf_n_meshes[gi]++;
+      n_attributes += m->primitives[pi].attributes_count;
     }
+    n_meshes += gltf_n_meshes[gi];
   }
-  printf("> loading n=%d meshes!\n", n_meshes);
+  LOG_INFO("> loading n=%d meshes!\n", n_meshes);
 
+  Arena* arena       = &model->arena;
   model->n_materials = gltf_data->materials_count;
-  model->materials   = calloc(model->n_materials, sizeof(Material));
+  model->materials =
+      arenaCalloc(arena, model->n_materials, sizeof(Material));
+  model->n_meshes = n_meshes;
+  model->meshes   = arenaCalloc(arena, n_meshes, sizeof(Mesh));
+
+  // the node hierarchy of the (only) scene
+  Scene* scene = &model->scene;
+  scene->nodes =
+      arenaCalloc(arena, gltf_data->nodes_count, sizeof(SceneNode));
+  int n_instance_transforms = 0;
+  FOR(ni, gltf_data->nodes_count) {
+    n_instance_transforms += gpuInstanceCount(&gltf_data->nodes[ni]);
+  }
+  scene->instance_transforms = arenaAllocAligned(
+      arena, n_instance_transforms * sizeof(float[16]), MODEL_ALIGNMENT
+  );
+  const cgltf_scene* gltf_scene = &gltf_data->scenes[0];
+  for (cgltf_size ni = 0; ni < gltf_scene->nodes_count; ni++) {
+    addSceneNode(
+        scene,
+        gltf_data,
+        gltf_scene->nodes[ni],
+        -1,
+        gltf_first_mesh,
+        gltf_n_meshes
+    );
+  }
+  updateSceneTransforms(scene);
+  endPhase(report, PHASE_SCENE, mark);
+  LOG_INFO("> loading n=%d nodes!\n", scene->n_nodes);
+  LOG_INFO("> loading n=%d gpu instances!\n", scene->n_instance_transforms);
+
+  // task arguments, they live until all tasks have finished
+  int n_images = gltf_data->images_count;
+  ImageTask* image_tasks =
+      arenaCalloc(&scratch, n_images, sizeof(*image_tasks));
+  int* material_images =
+      arenaCalloc(&scratch, model->n_materials, sizeof(int));
+  AttributeTask* attr_tasks =
+      arenaCalloc(&scratch, n_attributes, sizeof(*attr_tasks));
+  IndexTask* index_tasks =
+      arenaCalloc(&scratch, n_meshes, sizeof(*index_tasks));
 
   // load materials
   for (cgltf_size material_index = 0;
@@ -82,6 +578,8 @@ LoadModelRes loadModelFromGltfFile(const char* path, Model* model) {
     cgltf_material* m  = &(gltf_data->materials[material_index]);
     Material* material = &(model->materials[material_index]);
 
+    material_images[material_index] = -1;
+
     // we only handle PBR metallic / roughness flow
     if (m->has_pbr_metallic_roughness) {
 
@@ -100,78 +598,50 @@ LoadModelRes loadModelFromGltfFile(const char* path, Model* model) {
         continue;
       }
 
-      // read data from buffer
-      unsigned char* temp = malloc(bv->size);
-      int o               = (int)bv->offset;
-      int s               = (int)bv->stride ? (int)bv->stride : 1;
-      for (unsigned int j = 0; j < bv->size; j++, o += s)
-        temp[j] = ((unsigned char*)b->data)[o];
-
-      // then parse that data
-      ImageData image = {0};
-      int n_channels  = 0;
-      image.data      = stbi_load_from_memory(
-          temp, bv->size, &image.w, &image.h, &n_channels, 0
-      );
-      if (0 <= n_channels && n_channels < N_IMAGE_FORMATS)
-        image.format = n_channels;
-      if (image.data)
-        model->materials[material_index].textures[BASE].image = image;
+      // an image is decoded once, however many materials use it
+      int image_index                  = cgltf_image_index(gltf_data, i);
+      ImageTask* task                  = &image_tasks[image_index];
+      material_images[material_index] = image_index;
+      if (task->bytes) continue;
+
+      // glb images are stored contiguously in their buffer view. Only the
+      // header is read here, to size the decoded image.
+      const unsigned char* bytes = (unsigned char*)b->data + bv->offset;
+      int w, h, n_channels;
+      if (!stbi_info_from_memory(bytes, bv->size, &w, &h, &n_channels))
+        continue;
+
+      task->bytes     = bytes;
+      task->size      = bv->size;
+      task->pixels_size = (size_t)w * h * n_channels;
+      task->pixels =
+          arenaAllocAligned(arena, task->pixels_size, MODEL_ALIGNMENT);
+      report->bytes[DATA_IMAGES] += task->pixels_size;
+      report->n_images++;
+      submitTask(pool, &group, decodeImageTask, task);
     }
   }
 
   // load meshes
-  model->n_meshes = n_meshes;
-  model->meshes   = calloc(n_meshes, sizeof(Mesh));
-
-  int mesh_index = 0; // the currently 'being constructed' mesh
-  for (cgltf_size ni = 0; ni < gltf_data->nodes_count; ni++) {
-    cgltf_node* gltf_node =
-        &(gltf_data->nodes[ni]); // a node is a single 'object'
-    printf("> processing node %s\n", gltf_node->name);
-    cgltf_mesh* gltf_mesh = gltf_node->mesh; // which is contains one mesh
-
-    // the node might define some transform.
-    // moving each mesh to make the model as a whole.
-
-    /// world transform
-    cgltf_float trans[16];
-    cgltf_node_transform_world(gltf_node, trans);
-    cgltf_float trans_norm[16];
-    glm_mat4_inv((vec4*)trans, (vec4*)trans_norm);
-    glm_mat4_transpose((vec4*)trans_norm);
-
-    printf("world transform\n");
-    for (int i = 0; i < 4; i++) {
-      printf("[");
-      for (int j = 0; j < 4; j++) printf("%f, ", trans[i * 4 + j]);
-      printf("]\n");
-    }
-    printf("\n");
-
-    printf("world norm transform\n");
-    for (int i = 0; i < 4; i++) {
-      printf("[");
-      for (int j = 0; j < 4; j++) printf("%f, ", trans_norm[i * 4 + j]);
-      printf("]\n");
-    }
-    printf("\n");
+  int mesh_index      = 0; // the currently 'being constructed' mesh
+  int attribute_index = 0;
+  FOR(gi, n_gltf_meshes) {
+    cgltf_mesh* gltf_mesh = &gltf_data->meshes[gi];
+    LOG_DEBUG("> processing mesh %s\n", gltf_mesh->name);
 
     // the mesh contains several primitives
     // which defines its vertices, normals, tangents etc.
     // as done in raylib, we will create a Mesh for each such primitive
     for (cgltf_size pi = 0; pi < gltf_mesh->primitives_count; pi++) {
       cgltf_primitive* primitive = &(gltf_mesh->primitives[pi]);
-      printf("> processing primitive %zu\n", pi);
+      LOG_DEBUG("> processing primitive %zu\n", pi);
 
       // we don't support non triangular meshes
       if (primitive->type != cgltf_primitive_type_triangles) continue;
 
       // each primitive will correspond to one `Mesh`
-      // we will fill out the fields of this mesh
-      // instance by iterating through the attributes.
-      // When we've successfully filled all existing
-      // fields, we increase `mesh_index`
+      // we will queue a task for each of its attributes and for its
+      // indices. The tasks fill out the fields of this mesh instance.
       Mesh* mesh = &model->meshes[mesh_index];
 
       // we start by loading vertices, tangents, normals, texture coordinates
@@ -182,83 +652,96 @@ LoadModelRes loadModelFromGltfFile(const char* path, Model* model) {
         cgltf_type accessor_type            = accessor->type;
         cgltf_component_type component_type = accessor->component_type;
 
-        printf(
+        LOG_DEBUG(
             "> processing primitive %zu, attribute %zu - %s\n",
             pi,
             ai,
             attribute->name
         );
 
-        // we can load the data up front
-        // the accessor tells us how to extract the data from
-        // the gltf buffers
-        // number of bytes per element
-        cgltf_size n_vecs     = accessor->count;
-        cgltf_size floatCount = cgltf_accessor_unpack_floats(accessor, NULL, 0);
-        float* data           = (float*)calloc(floatCount, sizeof(float));
-        cgltf_accessor_unpack_floats(accessor, data, floatCount);
-
-        // depending on attribute type, set the correct field
-        if (IS_PRIMITIVE(position, vec3, r_32f)) {
-          mesh->n_vertices = n_vecs;
-          mesh->vertices   = data;
-          for (cgltf_size i = 0; i < n_vecs; i++) {
-            glm_mat4_mulv3((vec4*)trans, &data[3 * i], 1, &data[3 * i]);
-          }
-        } else if (IS_PRIMITIVE(normal, vec3, r_32f)) {
-          mesh->normals = data;
-          for (cgltf_size i = 0; i < n_vecs; i++) {
-            glm_mat4_mulv3((vec4*)trans_norm, &data[3 * i], 1, &data[3 * i]);
-          }
-        } else if (IS_PRIMITIVE(tangent, vec4, r_32f)) {
-          mesh->tangents = data;
-          for (cgltf_size i = 0; i < n_vecs; i++) {
-            glm_mat4_mulv3((vec4*)trans, &data[3 * i], 1, &data[3 * i]);
-          }
-        } else if (IS_PRIMITIVE(texcoord, vec2, r_32f)) {
+        // depending on attribute type, queue up the correct task
+        AttributeKind kind = ATTRIBUTE_POSITION;
+        AttributeFormat format;
+        bool supported = true;
+        if (IS_PRIMITIVE(position, vec3)) {
+          kind = ATTRIBUTE_POSITION;
+        } else if (IS_PRIMITIVE(normal, vec3)) {
+          kind = ATTRIBUTE_NORMAL;
+        } else if (IS_PRIMITIVE(tangent, vec4)) {
+          kind = ATTRIBUTE_TANGENT;
+        } else if (IS_PRIMITIVE(texcoord, vec2) && attribute->index == 0) {
           // only support one texture per mesh for now
-          if (attribute->index == 0) mesh->tex_coords = data;
+          kind = ATTRIBUTE_TEXCOORD;
         } else {
-          printf("> primitive is unsupported array\n");
-          printf(
+          supported = false;
+        }
+        if (!supported || !attributeFormat(accessor, kind, &format)) {
+          LOG_DEBUG("> primitive is unsupported array\n");
+          LOG_DEBUG(
               "> attribute type: %d, accessor type: %d, component type: %d\n",
               attribute_type,
               accessor_type,
               component_type
           );
           // unsupported!
+          continue;
+        }
+
+        // quantized attributes are widened into scratch memory for the
+        // passes below, the mesh keeps them in their file encoding
+        cgltf_size n_comps = cgltf_num_components(accessor->type);
+        Arena* storage     = format.type == COMPONENT_F32 ? arena : &scratch;
+        float* data        = arenaAllocAligned(
+            storage, accessor->count * n_comps * sizeof(float), MODEL_ALIGNMENT
+        );
+        *attributeField(mesh, kind) = data;
+        mesh->formats[kind]         = format;
+        if (kind == ATTRIBUTE_POSITION) mesh->n_vertices = accessor->count;
+        report->bytes[kind] +=
+            accessor->count * meshAttributeStride(mesh, kind);
+
+        AttributeTask* task = &attr_tasks[attribute_index++];
+        task->accessor      = accessor;
+        task->kind          = kind;
+        task->data          = data;
+        task->mesh          = NULL;
+        if (kind == ATTRIBUTE_POSITION) {
+          // the file usually knows the bounds already, but gives them in
+          // the integer range for normalized positions
+          if (accessor->has_min && accessor->has_max && !format.normalized)
+            meshBoundsFromBox(mesh, accessor->min, accessor->max);
+          else task->mesh = mesh;
         }
+        submitTask(pool, &group, unpackAttributeTask, task);
       }
       // then we check for and load indices
       if (primitive->indices) {
-        printf("> processing primitive %zu, checking if indices exists\n", pi);
-        cgltf_accessor* accessor  = primitive->indices;
-        cgltf_type accessor_type  = accessor->type;
-        cgltf_component_type type = accessor->component_type;
+        LOG_DEBUG(
+            "> processing primitive %zu, checking if indices exists\n", pi
+        );
+        cgltf_accessor* accessor = primitive->indices;
 
         // element size is should be same as component size
-        assert(accessor_type == cgltf_type_scalar);
-
-        cgltf_size n_elements = accessor->count;
-        cgltf_size size       = cgltf_component_size(type);
-        cgltf_size count =
-            cgltf_accessor_unpack_indices(accessor, NULL, size, 0);
-        assert(n_elements == count);
-        void* buffer = calloc(count, size);
-        cgltf_accessor_unpack_indices(accessor, buffer, size, count);
-
-        mesh->n_triangles = n_elements / 3;
-
-        // number of components
-        if (type == cgltf_component_type_r_16u) {
-          unsigned int* tmp = calloc(count, sizeof(unsigned int));
-          for (cgltf_size i = 0; i < n_elements; i++)
-            tmp[i] = ((unsigned short*)buffer)[i];
-          free(buffer);
-          mesh->indices = tmp;
-        } else if (type == cgltf_component_type_r_32u) {
-          mesh->indices = buffer;
+        assert(accessor->type == cgltf_type_scalar);
+
+        mesh->n_triangles = accessor->count / 3;
+
+        // keep the source width, but narrow 32 bit indices when they fit
+        switch (accessor->component_type) {
+        case cgltf_component_type_r_8u: mesh->index_type = INDEX_U8; break;
+        case cgltf_component_type_r_16u: mesh->index_type = INDEX_U16; break;
+        default: mesh->index_type = narrowIndexType(mesh->n_vertices); break;
         }
+
+        size_t index_bytes = accessor->count * indexSize(mesh->index_type);
+        mesh->indices =
+            arenaAllocAligned(arena, index_bytes, MODEL_ALIGNMENT);
+        report->bytes[DATA_INDICES] += index_bytes;
+
+        IndexTask* task = &index_tasks[mesh_index];
+        task->accessor  = accessor;
+        task->mesh      = mesh;
+        submitTask(pool, &group, unpackIndexTask, task);
       } else {
         mesh->n_triangles = mesh->n_vertices / 3;
       }
@@ -266,22 +749,84 @@ LoadModelRes loadModelFromGltfFile(const char* path, Model* model) {
     }
   }
 
+  // the tasks reference the gltf data, so it has to outlive them
+  waitTaskGroup(pool, &group);
+  FOR(ii, n_images) {
+    ImageTask* task = &image_tasks[ii];
+    addPhaseTime(&report->phases[PHASE_IMAGES], task->begin, task->end);
+  }
+  FOR(ai, attribute_index) {
+    AttributeTask* task = &attr_tasks[ai];
+    addPhaseTime(&report->phases[PHASE_ATTRIBUTES], task->begin, task->end);
+  }
+  FOR(mi, n_meshes) {
+    IndexTask* task = &index_tasks[mi];
+    addPhaseTime(&report->phases[PHASE_INDICES], task->begin, task->end);
+  }
+  FOR(mi, model->n_materials) {
+    int image_index = material_images[mi];
+    if (image_index < 0) continue;
+    model->materials[mi].textures[BASE].image = image_tasks[image_index].image;
+  }
+
+  // before the optimizer, which reorders the generated attributes with the
+  // others
+  mark = readClock();
+  generateMeshFrames(model->meshes, n_meshes, arena);
+  endPhase(report, PHASE_FRAMES, mark);
+
+  // every mesh is complete now, reorder them for the gpu
+  // the tasks allocate from arenas of their own, which are merged after
+  OptimizeTask* opt_tasks =
+      arenaCalloc(&scratch, n_meshes, sizeof(*opt_tasks));
+  FOR(mi, n_meshes) {
+    opt_tasks[mi].mesh = &model->meshes[mi];
+    submitTask(pool, &group, optimizeMeshTask, &opt_tasks[mi]);
+  }
+  waitTaskGroup(pool, &group);
+  FOR(mi, n_meshes) arenaMerge(arena, &opt_tasks[mi].arena);
+  FOR(mi, n_meshes) {
+    OptimizeTask* task = &opt_tasks[mi];
+    addPhaseTime(&report->phases[PHASE_OPTIMIZE], task->begin, task->end);
+  }
+  FOR(mi, n_meshes) {
+    MeshOptStats s = opt_tasks[mi].stats;
+    if (!model->meshes[mi].indices) continue;
+    LOG_DEBUG(
+        "> mesh %d: acmr %.3f -> %.3f, atvr %.3f -> %.3f\n",
+        mi,
+        s.before.acmr,
+        s.after.acmr,
+        s.before.atvr,
+        s.after.atvr
+    );
+    LOG_DEBUG("> mesh %d: %d meshlets\n", mi, model->meshes[mi].n_meshlets);
+    FOR(l, model->meshes[mi].n_lods) {
+      MeshLod* lod = &model->meshes[mi].lods[l];
+      LOG_DEBUG(
+          "> mesh %d: lod %d, %d triangles, error %f\n",
+          mi,
+          l + 1,
+          lod->n_triangles,
+          lod->error
+      );
+    }
+  }
+
   // clean:
-  if (gltf_data) cgltf_free(gltf_data);
+  arena_free(&scratch);
+  cgltf_free(gltf_data);
+  munmap(file, file_size);
 
   return SUCCESS;
 }
 #undef IS_PRIMITIVE
 
-void freeMesh(Mesh* mesh) {
-  if (mesh->vertices) free(mesh->vertices);
-  if (mesh->normals) free(mesh->normals);
-  if (mesh->tangents) free(mesh->tangents);
-  if (mesh->tex_coords) free(mesh->tex_coords);
-  if (mesh->indices) free(mesh->indices);
-}
-
 void freeModel(Model* model) {
-  for (int mi = 0; mi < model->n_meshes; mi++) freeMesh(&model->meshes[mi]);
-  free(model->meshes);
+  // cache backed models point into the mapping as well
+  if (model->mapping) releaseModelCache(model);
+  arena_free(&model->arena);
+  model->meshes    = NULL;
+  model->materials = NULL;
+  model->scene     = (Scene){0};
 }
@@ -0,0 +1,300 @@
+#include "models/quantize.h"
+#include "simd.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNORM16_MAX 65535.0f
+#define SNORM16_MAX 32767.0f
+
+// === scalar encoders ===
+
+static inline int16_t snorm16(float v) {
+  if (v > 1.0f) v = 1.0f;
+  if (v < -1.0f) v = -1.0f;
+  return (int16_t)lrintf(v * SNORM16_MAX);
+}
+
+/// maps a unit vector onto the octahedron and unfolds it into [-1, 1]^2
+static void octEncode(const float* n, float out[2]) {
+  float l1  = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+  float inv = l1 > 0.0f ? 1.0f / l1 : 0.0f;
+  float x   = n[0] * inv;
+  float y   = n[1] * inv;
+  if (n[2] < 0.0f) {
+    float ox = x;
+    x        = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    y        = (1.0f - fabsf(ox)) * (y >= 0.0f ? 1.0f : -1.0f);
+  }
+  out[0] = x;
+  out[1] = y;
+}
+
+/// IEEE 754 binary16, rounded to nearest even
+static uint16_t floatToHalf(float f) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  uint32_t abs  = x & 0x7fffffff;
+
+  // inf / nan
+  if (abs >= 0x7f800000)
+    return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+  // too large, rounds to inf
+  if (abs >= 0x477ff000) return sign | 0x7c00;
+  // subnormal halfs are multiples of 2^-24
+  if (abs < 0x38800000) {
+    float a;
+    memcpy(&a, &abs, sizeof(a));
+    return sign | (uint16_t)lrintf(a * 16777216.0f);
+  }
+  // rebias the exponent and round the mantissa
+  uint32_t h   = (abs - 0x38000000) >> 13;
+  uint32_t rem = abs & 0x1fff;
+  if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+  return sign | h;
+}
+
+#if defined(__SSE2__)
+// === SSE helpers ===
+
+/// two vectors of int32 in [0, 65535] -> 8 uint16
+static inline __m128i packU16(__m128i a, __m128i b) {
+  // SSE2 only has a signed saturating pack, so bias into the signed range
+  const __m128i bias = _mm_set1_epi32(32768);
+  __m128i p = _mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_sub_epi32(b, bias));
+  return _mm_xor_si128(p, _mm_set1_epi16((short)0x8000));
+}
+
+static inline __m128 clamp4(__m128 v, float lo, float hi) {
+  return _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(lo)), _mm_set1_ps(hi));
+}
+
+/// `magnitude` with the sign of `sign`
+static inline __m128 copySign4(__m128 magnitude, __m128 sign) {
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  return _mm_or_ps(
+      _mm_andnot_ps(sign_mask, magnitude), _mm_and_ps(sign_mask, sign)
+  );
+}
+
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline void
+octEncode4(__m128 x, __m128 y, __m128 z, __m128* ox, __m128* oy) {
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  const __m128 one       = _mm_set1_ps(1.0f);
+  __m128 ax              = _mm_andnot_ps(sign_mask, x);
+  __m128 ay              = _mm_andnot_ps(sign_mask, y);
+  __m128 az              = _mm_andnot_ps(sign_mask, z);
+  __m128 l1              = _mm_add_ps(_mm_add_ps(ax, ay), az);
+  __m128 inv = _mm_div_ps(one, _mm_max_ps(l1, _mm_set1_ps(FLT_MIN)));
+  x          = _mm_mul_ps(x, inv);
+  y          = _mm_mul_ps(y, inv);
+
+  // fold the lower hemisphere over the diagonals
+  __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+  __m128 fx    = copySign4(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, y)), x);
+  __m128 fy    = copySign4(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, x)), y);
+  *ox          = select4(lower, fx, x);
+  *oy          = select4(lower, fy, y);
+}
+#endif
+
+void quantizePositions(
+    const float* src, int n, const float offset[3], const float scale[3],
+    uint16_t* dst
+) {
+  // flat axes have a scale of 0 and encode to 0
+  float mul[3];
+  for (int c = 0; c < 3; c++)
+    mul[c] = scale[c] > 0.0f ? UNORM16_MAX / scale[c] : 0.0f;
+
+  int i = 0;
+#if defined(__SSE2__)
+  __m128 off_x = _mm_set1_ps(offset[0]), mul_x = _mm_set1_ps(mul[0]);
+  __m128 off_y = _mm_set1_ps(offset[1]), mul_y = _mm_set1_ps(mul[1]);
+  __m128 off_z = _mm_set1_ps(offset[2]), mul_z = _mm_set1_ps(mul[2]);
+  for (; i + 4 <= n; i += 4) {
+    __m128 x, y, z, w = _mm_setzero_ps();
+    load3x4(&src[i * 3], &x, &y, &z);
+    x = clamp4(_mm_mul_ps(_mm_sub_ps(x, off_x), mul_x), 0, UNORM16_MAX);
+    y = clamp4(_mm_mul_ps(_mm_sub_ps(y, off_y), mul_y), 0, UNORM16_MAX);
+    z = clamp4(_mm_mul_ps(_mm_sub_ps(z, off_z), mul_z), 0, UNORM16_MAX);
+    // back to one (x, y, z, 0) row per vertex
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    __m128i v01 = packU16(_mm_cvtps_epi32(x), _mm_cvtps_epi32(y));
+    __m128i v23 = packU16(_mm_cvtps_epi32(z), _mm_cvtps_epi32(w));
+    _mm_storeu_si128((__m128i*)&dst[i * 4 + 0], v01);
+    _mm_storeu_si128((__m128i*)&dst[i * 4 + 8], v23);
+  }
+#endif
+  for (; i < n; i++) {
+    for (int c = 0; c < 3; c++) {
+      float v = (src[i * 3 + c] - offset[c]) * mul[c];
+      v       = v < 0.0f ? 0.0f : v > UNORM16_MAX ? UNORM16_MAX : v;
+      dst[i * 4 + c] = (uint16_t)lrintf(v);
+    }
+    dst[i * 4 + 3] = 0;
+  }
+}
+
+void encodeOctNormals(const float* src, int n, int16_t* dst) {
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128 max = _mm_set1_ps(SNORM16_MAX);
+  for (; i + 4 <= n; i += 4) {
+    __m128 x, y, z, ox, oy;
+    load3x4(&src[i * 3], &x, &y, &z);
+    octEncode4(x, y, z, &ox, &oy);
+    __m128i qx = _mm_cvtps_epi32(_mm_mul_ps(clamp4(ox, -1, 1), max));
+    __m128i qy = _mm_cvtps_epi32(_mm_mul_ps(clamp4(oy, -1, 1), max));
+    // interleave to x0 y0 x1 y1 ...
+    __m128i q = _mm_packs_epi32(
+        _mm_unpacklo_epi32(qx, qy), _mm_unpackhi_epi32(qx, qy)
+    );
+    _mm_storeu_si128((__m128i*)&dst[i * 2], q);
+  }
+#endif
+  for (; i < n; i++) {
+    float o[2];
+    octEncode(&src[i * 3], o);
+    dst[i * 2 + 0] = snorm16(o[0]);
+    dst[i * 2 + 1] = snorm16(o[1]);
+  }
+}
+
+void encodeOctTangents(const float* src, int n, int16_t* dst) {
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128 max = _mm_set1_ps(SNORM16_MAX);
+  for (; i + 4 <= n; i += 4) {
+    const float* p = &src[i * 4];
+    __m128 x = _mm_loadu_ps(p + 0), y = _mm_loadu_ps(p + 4);
+    __m128 z = _mm_loadu_ps(p + 8), w = _mm_loadu_ps(p + 12);
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    __m128 ox, oy;
+    octEncode4(x, y, z, &ox, &oy);
+    ox = _mm_mul_ps(clamp4(ox, -1, 1), max);
+    oy = _mm_mul_ps(clamp4(oy, -1, 1), max);
+    // only the sign of the handedness is kept
+    __m128 negative = _mm_cmplt_ps(w, _mm_setzero_ps());
+    __m128 s        = select4(negative, _mm_set1_ps(-1), _mm_set1_ps(1));
+    s               = _mm_mul_ps(s, max);
+    __m128 pad      = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(ox, oy, s, pad);
+    __m128i v01 = _mm_packs_epi32(_mm_cvtps_epi32(ox), _mm_cvtps_epi32(oy));
+    __m128i v23 = _mm_packs_epi32(_mm_cvtps_epi32(s), _mm_cvtps_epi32(pad));
+    _mm_storeu_si128((__m128i*)&dst[i * 4 + 0], v01);
+    _mm_storeu_si128((__m128i*)&dst[i * 4 + 8], v23);
+  }
+#endif
+  for (; i < n; i++) {
+    float o[2];
+    octEncode(&src[i * 4], o);
+    dst[i * 4 + 0] = snorm16(o[0]);
+    dst[i * 4 + 1] = snorm16(o[1]);
+    dst[i * 4 + 2] = src[i * 4 + 3] < 0.0f ? -32767 : 32767;
+    dst[i * 4 + 3] = 0;
+  }
+}
+
+#if defined(SIMD_DISPATCH)
+/// the whole blocks of 4 of `encodeHalfs`, returns how many were encoded
+SIMD_TARGET("f16c") static int encodeHalfsF16C(
+    const float* src, int n, uint16_t* dst
+) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 v  = _mm_loadu_ps(&src[i]);
+    __m128i h = _mm_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT);
+    _mm_storel_epi64((__m128i*)&dst[i], h);
+  }
+  return i;
+}
+#endif
+
+void encodeHalfs(const float* src, int n, uint16_t* dst) {
+  int i = 0;
+#if defined(SIMD_DISPATCH)
+  // the build may not include F16C, ask the cpu
+  if (__builtin_cpu_supports("f16c")) i = encodeHalfsF16C(src, n, dst);
+#endif
+  for (; i < n; i++) dst[i] = floatToHalf(src[i]);
+}
+
+// the integer range of each component type, see `ComponentType`
+static const float COMPONENT_MIN[N_COMPONENT_TYPES] = {
+    0, -128, 0, -32768, 0
+};
+static const float COMPONENT_MAX[N_COMPONENT_TYPES] = {
+    0, 127, 255, 32767, 65535
+};
+
+void encodeComponents(
+    const float* src, int n, int n_comps, AttributeFormat format, void* dst
+) {
+  int size      = componentSize(format.type);
+  size_t stride = (n_comps * size + 3) & ~3;
+  if (format.type == COMPONENT_F32) {
+    memcpy(dst, src, n * stride);
+    return;
+  }
+  // normalized components were divided by the largest value of the type,
+  // the others were read as is, so rounding recovers them exactly
+  float lo     = COMPONENT_MIN[format.type];
+  float hi     = COMPONENT_MAX[format.type];
+  float mul    = format.normalized ? hi : 1.0f;
+  uint8_t* out = dst;
+  memset(out, 0, n * stride);
+  for (int i = 0; i < n; i++, out += stride) {
+    for (int c = 0; c < n_comps; c++) {
+      float v   = src[i * n_comps + c] * mul;
+      int32_t q = lrintf(v < lo ? lo : v > hi ? hi : v);
+      // two's complement, the same bits for signed and unsigned types
+      if (size == 1) {
+        out[c] = (uint8_t)(q & 0xff);
+      } else {
+        uint16_t h = (uint16_t)(q & 0xffff);
+        memcpy(&out[c * 2], &h, sizeof(h));
+      }
+    }
+  }
+}
+
+void quantizeMesh(const Mesh* m, QuantizedMesh* q) {
+  int n         = m->n_vertices;
+  *q            = (QuantizedMesh){0};
+  q->n_vertices = n;
+
+  if (m->vertices) {
+    // the bounds were computed at import, see models/bounds.h
+    const MeshBounds* b = &m->bounds;
+    for (int c = 0; c < 3; c++) {
+      q->pos_offset[c] = b->min[c];
+      q->pos_scale[c]  = b->max[c] - b->min[c];
+    }
+    q->positions = malloc(n * 4 * sizeof(uint16_t));
+    if (q->positions)
+      quantizePositions(
+          m->vertices, n, q->pos_offset, q->pos_scale, q->positions
+      );
+  }
+  if (m->normals && (q->normals = malloc(n * 2 * sizeof(int16_t))))
+    encodeOctNormals(m->normals, n, q->normals);
+  if (m->tangents && (q->tangents = malloc(n * 4 * sizeof(int16_t))))
+    encodeOctTangents(m->tangents, n, q->tangents);
+  if (m->tex_coords && (q->tex_coords = malloc(n * 2 * sizeof(uint16_t))))
+    encodeHalfs(m->tex_coords, n * 2, q->tex_coords);
+}
+
+void freeQuantizedMesh(QuantizedMesh* q) {
+  free(q->positions);
+  free(q->normals);
+  free(q->tangents);
+  free(q->tex_coords);
+  *q = (QuantizedMesh){0};
+}
@@ -0,0 +1,138 @@
+#include "registry.h"
+#include "textures/texture_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+/// hash of everything `syncBuffers` uploads
+static AssetKey hashMesh(const Mesh* m, VertexLayout layout, bool quantize) {
+  int32_t shape[4 + MAX_MESH_LODS] = {
+      m->n_vertices, m->n_triangles, m->index_type, m->n_lods
+  };
+  FOR(l, m->n_lods) shape[4 + l] = m->lods[l].n_triangles;
+  // the file formats pick the upload format of their attributes
+  int32_t format[2 + 2 * N_MESH_ATTRIBUTES] = {layout, quantize};
+  FOR(k, N_MESH_ATTRIBUTES) {
+    format[2 + 2 * k]     = m->formats[k].type;
+    format[2 + 2 * k + 1] = m->formats[k].normalized;
+  }
+  AssetKey key = hashAsset(shape, sizeof(shape), (AssetKey){0});
+  key          = hashAsset(format, sizeof(format), key);
+
+  FOR(k, N_MESH_ATTRIBUTES) {
+    // a missing attribute hashes differently from an empty one
+    const void* data = meshAttribute(m, k);
+    int32_t present  = data != NULL;
+    size_t size      = (size_t)m->n_vertices * meshAttributeStride(m, k);
+    key              = hashAsset(&present, sizeof(present), key);
+    if (present) key = hashAsset(data, size, key);
+  }
+  size_t index_size = indexSize(m->index_type);
+  if (m->indices)
+    key = hashAsset(m->indices, (size_t)m->n_triangles * 3 * index_size, key);
+  FOR(l, m->n_lods) {
+    size_t size = (size_t)m->lods[l].n_triangles * 3 * index_size;
+    key         = hashAsset(m->lods[l].indices, size, key);
+  }
+  return key;
+}
+
+/// the live resource with `key`, 0 when there is none
+static ResourceHandle findResource(
+    Registry* registry, ResourceKind kind, AssetKey key
+) {
+  FOR(i, registry->n_resources) {
+    Resource* r = &registry->resources[i];
+    if (r->refs && r->kind == kind && r->key.lo == key.lo &&
+        r->key.hi == key.hi) {
+      r->refs++;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+/// a free slot, 0 when out of memory
+static ResourceHandle newResource(
+    Registry* registry, ResourceKind kind, AssetKey key
+) {
+  int i = 0;
+  while (i < registry->n_resources && registry->resources[i].refs) i++;
+  if (i == registry->capacity) {
+    int capacity    = registry->capacity ? 2 * registry->capacity : 16;
+    Resource* grown = realloc(registry->resources, capacity * sizeof(Resource));
+    if (!grown) return 0;
+    registry->resources = grown;
+    registry->capacity  = capacity;
+  }
+  if (i == registry->n_resources) registry->n_resources++;
+  registry->resources[i] = (Resource){.key = key, .kind = kind, .refs = 1};
+  return i + 1;
+}
+
+ResourceHandle acquireTexture(
+    Registry* registry, const ImageData* image, TextureUsage usage,
+    TextureStream* stream
+) {
+  if (!image->data) return 0;
+  int32_t settings[] = {usage};
+  AssetKey key = hashAsset(settings, sizeof(settings), hashImage(image));
+  ResourceHandle handle = findResource(registry, RESOURCE_TEXTURE, key);
+  if (handle) return handle;
+
+  GLuint texture = stream ? streamImage(stream, image, usage)
+                          : uploadImage(image, usage);
+  if (!texture) return 0;
+  handle = newResource(registry, RESOURCE_TEXTURE, key);
+  if (!handle) {
+    glDeleteTextures(1, &texture);
+    return 0;
+  }
+  registry->resources[handle - 1].texture = texture;
+  return handle;
+}
+
+ResourceHandle acquireMesh(
+    Registry* registry, const Mesh* m, VertexLayout layout, bool quantize
+) {
+  AssetKey key          = hashMesh(m, layout, quantize);
+  ResourceHandle handle = findResource(registry, RESOURCE_MESH, key);
+  if (handle) return handle;
+
+  handle = newResource(registry, RESOURCE_MESH, key);
+  if (!handle) return 0;
+  GlIdentifier* ids = &registry->resources[handle - 1].mesh;
+  genGlIds(ids, 1, layout, quantize);
+  // the upload only reads the mesh
+  syncBuffers((Mesh*)m, ids, 1);
+  return handle;
+}
+
+static void deleteResource(Resource* r) {
+  if (r->kind == RESOURCE_TEXTURE) glDeleteTextures(1, &r->texture);
+  else freeGlIds(&r->mesh, 1);
+  *r = (Resource){0};
+}
+
+void releaseResource(Registry* registry, ResourceHandle handle) {
+  if (handle <= 0 || handle > registry->n_resources) return;
+  Resource* r = &registry->resources[handle - 1];
+  if (r->refs && --r->refs == 0) deleteResource(r);
+}
+
+GLuint resourceTexture(const Registry* registry, ResourceHandle handle) {
+  if (handle <= 0 || handle > registry->n_resources) return 0;
+  return registry->resources[handle - 1].texture;
+}
+
+GlIdentifier* resourceMesh(Registry* registry, ResourceHandle handle) {
+  if (handle <= 0 || handle > registry->n_resources) return NULL;
+  return &registry->resources[handle - 1].mesh;
+}
+
+void freeRegistry(Registry* registry) {
+  FOR(i, registry->n_resources) {
+    if (registry->resources[i].refs) deleteResource(&registry->resources[i]);
+  }
+  free(registry->resources);
+  *registry = (Registry){0};
+}
@@ -0,0 +1,140 @@
+#include "models/scene.h"
+#include "util.h"
+#include <stdlib.h>
+#include <string.h>
+
+void multiplyTransforms(const float a[16], const float b[16], float out[16]) {
+  float r[16];
+  FOR(c, 4) {
+    FOR(row, 4) {
+      r[c * 4 + row] = a[0 * 4 + row] * b[c * 4 + 0] +
+                       a[1 * 4 + row] * b[c * 4 + 1] +
+                       a[2 * 4 + row] * b[c * 4 + 2] +
+                       a[3 * 4 + row] * b[c * 4 + 3];
+    }
+  }
+  memcpy(out, r, sizeof(r));
+}
+
+void composeTransform(
+    const float translation[3], const float rotation[4], const float scale[3],
+    float out[16]
+) {
+  float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+  // the columns of the rotation, scaled
+  out[0]  = (1 - 2 * (y * y + z * z)) * scale[0];
+  out[1]  = 2 * (x * y + z * w) * scale[0];
+  out[2]  = 2 * (x * z - y * w) * scale[0];
+  out[3]  = 0;
+  out[4]  = 2 * (x * y - z * w) * scale[1];
+  out[5]  = (1 - 2 * (x * x + z * z)) * scale[1];
+  out[6]  = 2 * (y * z + x * w) * scale[1];
+  out[7]  = 0;
+  out[8]  = 2 * (x * z + y * w) * scale[2];
+  out[9]  = 2 * (y * z - x * w) * scale[2];
+  out[10] = (1 - 2 * (x * x + y * y)) * scale[2];
+  out[11] = 0;
+  out[12] = translation[0];
+  out[13] = translation[1];
+  out[14] = translation[2];
+  out[15] = 1;
+}
+
+/// how often the meshes of `node` are drawn
+static int nodeInstances(const SceneNode* node) {
+  return node->n_instances ? node->n_instances : 1;
+}
+
+void updateSceneTransforms(Scene* scene) {
+  // parents come first, so their world transform is always up to date
+  FOR(i, scene->n_nodes) {
+    SceneNode* node = &scene->nodes[i];
+    if (node->parent < 0) {
+      memcpy(node->world, node->local, sizeof(node->world));
+    } else {
+      const float* parent = scene->nodes[node->parent].world;
+      multiplyTransforms(parent, node->local, node->world);
+    }
+  }
+}
+
+bool buildSceneInstances(
+    const Scene* scene, int n_meshes, SceneInstances* instances
+) {
+  *instances = (SceneInstances){0};
+
+  // I. count the instances of every mesh
+  int* counts = calloc(n_meshes + 1, sizeof(int));
+  if (!counts) return false;
+  int n = 0;
+  FOR(i, scene->n_nodes) {
+    const SceneNode* node = &scene->nodes[i];
+    FOR(k, node->n_meshes) {
+      counts[node->first_mesh + k] += nodeInstances(node);
+      n += nodeInstances(node);
+    }
+  }
+  int n_batches = 0;
+  FOR(m, n_meshes) n_batches += counts[m] > 0;
+
+  instances->batches    = malloc(n_batches * sizeof(SceneBatch) + 1);
+  instances->nodes      = malloc(n * sizeof(int) + 1);
+  instances->transforms = malloc(n * sizeof(int) + 1);
+  instances->matrices   = malloc(n * sizeof(*instances->matrices) + 1);
+  if (!instances->batches || !instances->nodes || !instances->transforms ||
+      !instances->matrices) {
+    free(counts);
+    freeSceneInstances(instances);
+    return false;
+  }
+
+  // II. one batch per used mesh, `counts` becomes the next free slot
+  int first = 0;
+  FOR(m, n_meshes) {
+    if (!counts[m]) continue;
+    instances->batches[instances->n_batches++] =
+        (SceneBatch){m, first, counts[m]};
+    int c     = counts[m];
+    counts[m] = first;
+    first += c;
+  }
+
+  // III. and the nodes sorted into their batches
+  FOR(i, scene->n_nodes) {
+    const SceneNode* node = &scene->nodes[i];
+    FOR(k, node->n_meshes) {
+      FOR(j, nodeInstances(node)) {
+        int slot                    = counts[node->first_mesh + k]++;
+        instances->nodes[slot]      = i;
+        instances->transforms[slot] =
+            node->n_instances ? node->first_instance + j : -1;
+      }
+    }
+  }
+  instances->n_instances = n;
+  free(counts);
+  updateSceneInstances(scene, instances);
+  return true;
+}
+
+void updateSceneInstances(const Scene* scene, SceneInstances* instances) {
+  FOR(i, instances->n_instances) {
+    const float* world = scene->nodes[instances->nodes[i]].world;
+    int t              = instances->transforms[i];
+    if (t < 0) {
+      memcpy(instances->matrices[i], world, sizeof(instances->matrices[i]));
+    } else {
+      multiplyTransforms(
+          world, scene->instance_transforms[t], instances->matrices[i]
+      );
+    }
+  }
+}
+
+void freeSceneInstances(SceneInstances* instances) {
+  free(instances->batches);
+  free(instances->nodes);
+  free(instances->transforms);
+  free(instances->matrices);
+  *instances = (SceneInstances){0};
+}
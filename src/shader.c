@@ -1,24 +1,32 @@
 #include "shaders/shader.h"
+#include "asset_cache.h"
+#include "util.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-GLuint initShader(GLenum type, const char* shader_src) {
+char* readShaderSource(const char* shader_src) {
   // read file
   FILE* f = fopen(shader_src, "r"); // open file
-  if (!f) return 0;
+  if (!f) return NULL;
   fseek(f, 0, SEEK_END);
   long length = ftell(f); // find length of file
   fseek(f, 0, SEEK_SET);
   char* buffer = malloc(length + 1); // allocate memory for file
-  if (!buffer) return 0;
+  if (!buffer) {
+    fclose(f);
+    return NULL;
+  }
   fread(buffer, 1, length, f); // copy file
   buffer[length] = 0;          // make sure to zero terminate it
   fclose(f);                   // close file object
+  return buffer;
+}
 
+GLuint initShader(GLenum type, const char* source) {
   GLuint obj = glCreateShader(type);
-  glShaderSource(obj, 1, &buffer, NULL);
+  glShaderSource(obj, 1, &source, NULL);
   glCompileShader(obj);
-  free(buffer); // free the buffer
   return obj;
 }
 
@@ -38,6 +46,8 @@ bool shaderIsValid(GLuint shader) {
 
 GLuint linkShaders(GLuint v_shader, GLuint f_shader) {
   GLuint program = glCreateProgram();
+  // keep the binary around for the program cache
+  glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   glAttachShader(program, v_shader);
   glAttachShader(program, f_shader);
   glLinkProgram(program);
@@ -56,27 +66,137 @@ bool shaderProgramIsValid(GLuint program) {
   return true;
 }
 
+// === program cache ===
+
+/// binaries only load on the driver that produced them, so its strings
+/// are part of the key
+static AssetKey programKey(const char* v_source, const char* f_source) {
+  const char* parts[] = {
+      v_source,
+      f_source,
+      (const char*)glGetString(GL_VENDOR),
+      (const char*)glGetString(GL_RENDERER),
+      (const char*)glGetString(GL_VERSION),
+  };
+  AssetKey key = {0};
+  FOR(i, sizeof(parts) / sizeof(parts[0])) {
+    if (parts[i]) key = hashAsset(parts[i], strlen(parts[i]), key);
+  }
+  return key;
+}
+
+static bool programBinariesSupported(void) {
+  GLint n_formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+  return n_formats > 0;
+}
+
+/// 0 when missing, or rejected by the driver
+static GLuint loadProgramBinary(const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return 0;
+  ProgramCacheHeader header;
+  void* binary = NULL;
+
+  bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+            header.magic == PROGRAM_CACHE_MAGIC &&
+            header.version == PROGRAM_CACHE_VERSION &&
+            (binary = malloc(header.size)) &&
+            fread(binary, 1, header.size, f) == header.size;
+  fclose(f);
+  if (!ok) {
+    free(binary);
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glProgramBinary(program, header.format, binary, header.size);
+  free(binary);
+  GLint linked = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    glDeleteProgram(program);
+    return 0;
+  }
+  assetHit(ASSET_PROGRAM, path, sizeof(header) + header.size);
+  return program;
+}
+
+static void writeProgramBinary(const char* path, GLuint program) {
+  GLint size = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+  void* binary = size > 0 ? malloc(size) : NULL;
+  if (!binary) return;
+  GLenum format;
+  glGetProgramBinary(program, size, &size, &format, binary);
+
+  char tmp_path[1024];
+  FILE* f = beginAsset(path, tmp_path, sizeof(tmp_path));
+  if (f) {
+    ProgramCacheHeader header = {
+        .magic   = PROGRAM_CACHE_MAGIC,
+        .version = PROGRAM_CACHE_VERSION,
+        .format  = format,
+        .size    = size,
+    };
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(binary, 1, size, f) == (size_t)size;
+    endAsset(ASSET_PROGRAM, f, tmp_path, path, ok);
+  }
+  free(binary);
+}
+
 #define initVShader(src) initShader(GL_VERTEX_SHADER, src)
 #define initFShader(src) initShader(GL_FRAGMENT_SHADER, src)
 GLuint loadShader(const char* v_path, const char* f_path) {
-  GLuint v = initVShader(v_path);
-  GLuint f = initFShader(f_path);
-  if (!v || !f) return 0;
-  bool ok = shaderIsValid(v) && shaderIsValid(f);
-  if (!ok) return 0;
-  GLuint shader = linkShaders(v, f);
-  ok            = shaderProgramIsValid(shader);
-  if (!ok) return 0;
+  GLuint shader  = 0;
+  char* v_source = readShaderSource(v_path);
+  char* f_source = readShaderSource(f_path);
+  if (!v_source || !f_source) goto clean;
+
+  // a program linked from the same sources before is loaded as is
+  char path[1024];
+  bool cached = programBinariesSupported() &&
+                assetPath(
+                    path,
+                    sizeof(path),
+                    ASSET_PROGRAM,
+                    programKey(v_source, f_source)
+                );
+  if (cached && (shader = loadProgramBinary(path))) goto clean;
+  if (cached) assetMiss(ASSET_PROGRAM);
+
+  GLuint v = initVShader(v_source);
+  GLuint f = initFShader(f_source);
+  if (shaderIsValid(v) && shaderIsValid(f)) {
+    shader = linkShaders(v, f);
+    if (!shaderProgramIsValid(shader)) {
+      glDeleteProgram(shader);
+      shader = 0;
+    }
+  }
+  // the program keeps what it needs
+  glDeleteShader(v);
+  glDeleteShader(f);
+  if (shader && cached) writeProgramBinary(path, shader);
+
+clean:
+  free(v_source);
+  free(f_source);
   return shader;
 }
 
 ShaderVars loadShaderVars(GLuint shader) {
   ShaderVars v = {0};
 
-  v.model      = glGetUniformLocation(shader, "model");
-  v.view       = glGetUniformLocation(shader, "view");
-  v.projection = glGetUniformLocation(shader, "projection");
-  v.texture_0  = glGetUniformLocation(shader, "texture_0");
+  v.model        = glGetUniformLocation(shader, "model");
+  v.view         = glGetUniformLocation(shader, "view");
+  v.projection   = glGetUniformLocation(shader, "projection");
+  v.texture_0    = glGetUniformLocation(shader, "texture_0");
+  v.oct_normals  = glGetUniformLocation(shader, "oct_normals");
+  v.oct_tangents = glGetUniformLocation(shader, "oct_tangents");
+  v.pos_offset   = glGetUniformLocation(shader, "pos_offset");
+  v.pos_scale    = glGetUniformLocation(shader, "pos_scale");
 
   return v;
 }
@@ -0,0 +1,290 @@
+#include "models/tangents.h"
+#include "thread_pool.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// vertices normalized by one reduction task
+#define REDUCE_VERTICES 65536
+
+typedef enum {
+  PASS_NORMALS,
+  PASS_TANGENTS,
+} FramePass;
+
+// floats summed per vertex, the tangent pass sums tangent and bitangent
+static int passWidth(FramePass pass) { return pass == PASS_NORMALS ? 3 : 6; }
+
+// the attribute `pass` fills
+static float** passField(Mesh* m, FramePass pass) {
+  return pass == PASS_NORMALS ? &m->normals : &m->tangents;
+}
+
+/// sums the faces of a range of triangles into a part of its own
+typedef struct {
+  const Mesh* mesh;
+  FramePass pass;
+  int first_triangle;
+  int n_triangles;
+  float* sum; // `passWidth` floats per vertex, zeroed
+} AccumulateTask;
+
+/// adds the parts up for a range of vertices and writes the result
+typedef struct {
+  Mesh* mesh;
+  FramePass pass;
+  float** parts;
+  int n_parts;
+  int first_vertex;
+  int n_vertices;
+} ReduceTask;
+
+/// one pass over one mesh
+typedef struct {
+  Mesh* mesh;
+  float* parts[FRAME_MAX_PARTS];
+  int n_parts;
+  bool failed; // out of memory, the mesh does not get the attribute
+} FrameJob;
+
+static uint32_t readIndex(const Mesh* m, int i) {
+  if (!m->indices) return i;
+  switch (m->index_type) {
+  case INDEX_U8: return ((const uint8_t*)m->indices)[i];
+  case INDEX_U16: return ((const uint16_t*)m->indices)[i];
+  default: return ((const uint32_t*)m->indices)[i];
+  }
+}
+
+static void sub(const float* a, const float* b, float* out) {
+  FOR(k, 3) out[k] = a[k] - b[k];
+}
+
+static float dot(const float* a, const float* b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void cross(const float* a, const float* b, float* out) {
+  out[0] = a[1] * b[2] - a[2] * b[1];
+  out[1] = a[2] * b[0] - a[0] * b[2];
+  out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static bool normalize(float* v) {
+  float len = sqrtf(dot(v, v));
+  if (!(len > 1e-20f)) return false;
+  FOR(k, 3) v[k] /= len;
+  return true;
+}
+
+/// the angle at corner `c` of the triangle
+static float cornerAngle(const float* p[3], int c) {
+  float e1[3], e2[3];
+  sub(p[(c + 1) % 3], p[c], e1);
+  sub(p[(c + 2) % 3], p[c], e2);
+  if (!normalize(e1) || !normalize(e2)) return 0.0f;
+  float d = dot(e1, e2);
+  return acosf(d < -1.0f ? -1.0f : d > 1.0f ? 1.0f : d);
+}
+
+static void accumulateTask(void* arg) {
+  AccumulateTask* task = arg;
+  const Mesh* m        = task->mesh;
+  int width            = passWidth(task->pass);
+  int end              = task->first_triangle + task->n_triangles;
+
+  for (int t = task->first_triangle; t < end; t++) {
+    uint32_t v[3];
+    const float* p[3];
+    FOR(c, 3) {
+      v[c] = readIndex(m, t * 3 + c);
+      if (v[c] >= (uint32_t)m->n_vertices) goto next;
+      p[c] = &m->vertices[v[c] * 3];
+    }
+    float e1[3], e2[3];
+    sub(p[1], p[0], e1);
+    sub(p[2], p[0], e2);
+
+    if (task->pass == PASS_NORMALS) {
+      // the length of the cross product is twice the area, which is
+      // exactly the weight we want
+      float n[3];
+      cross(e1, e2, n);
+      FOR(c, 3) FOR(k, 3) task->sum[v[c] * 3 + k] += n[k];
+      continue;
+    }
+
+    // the directions in which u and v grow over the face
+    const float* uv[3];
+    FOR(c, 3) uv[c] = &m->tex_coords[v[c] * 2];
+    float du1 = uv[1][0] - uv[0][0], dv1 = uv[1][1] - uv[0][1];
+    float du2 = uv[2][0] - uv[0][0], dv2 = uv[2][1] - uv[0][1];
+    float det = du1 * dv2 - du2 * dv1;
+    if (fabsf(det) < 1e-20f) continue;
+    float r = 1.0f / det;
+    float s[3], b[3];
+    FOR(k, 3) {
+      s[k] = (e1[k] * dv2 - e2[k] * dv1) * r;
+      b[k] = (e2[k] * du1 - e1[k] * du2) * r;
+    }
+    if (!normalize(s) || !normalize(b)) continue;
+    FOR(c, 3) {
+      float w    = cornerAngle(p, c);
+      float* sum = &task->sum[v[c] * width];
+      FOR(k, 3) {
+        sum[k] += s[k] * w;
+        sum[3 + k] += b[k] * w;
+      }
+    }
+  next:;
+  }
+}
+
+static void reduceTask(void* arg) {
+  ReduceTask* task = arg;
+  Mesh* m          = task->mesh;
+  int width        = passWidth(task->pass);
+  int end          = task->first_vertex + task->n_vertices;
+
+  for (int i = task->first_vertex; i < end; i++) {
+    float sum[6] = {0};
+    FOR(p, task->n_parts) FOR(k, width) sum[k] += task->parts[p][i * width + k];
+
+    if (task->pass == PASS_NORMALS) {
+      // unreferenced and degenerate vertices still get a unit normal
+      if (!normalize(sum)) sum[0] = sum[1] = 0.0f, sum[2] = 1.0f;
+      memcpy(&m->normals[i * 3], sum, 3 * sizeof(float));
+      continue;
+    }
+
+    // Gram-Schmidt against the normal, and the handedness of the frame
+    const float* n = &m->normals[i * 3];
+    float t[3];
+    FOR(k, 3) t[k] = sum[k] - n[k] * dot(n, sum);
+    if (!normalize(t)) {
+      // no usable uv gradient, any direction in the tangent plane will do
+      float axis[3] = {fabsf(n[0]) < 0.9f ? 1.0f : 0.0f, 0.0f, 0.0f};
+      if (axis[0] == 0.0f) axis[1] = 1.0f;
+      float c[3];
+      cross(n, axis, c);
+      cross(c, n, t);
+      normalize(t);
+    }
+    float nt[3];
+    cross(n, t, nt);
+    float* out = &m->tangents[i * 4];
+    memcpy(out, t, 3 * sizeof(float));
+    out[3] = dot(nt, &sum[3]) < 0.0f ? -1.0f : 1.0f;
+  }
+}
+
+/// runs `pass` over every mesh in `jobs`, both stages spread over the pool
+static void runPass(FrameJob* jobs, int n_jobs, FramePass pass, int n_threads) {
+  ThreadPool* pool = sharedThreadPool();
+  TaskGroup group  = {0};
+  int width        = passWidth(pass);
+
+  // I. the parts of every mesh accumulate at the same time
+  int n_tasks = 0;
+  FOR(j, n_jobs) n_tasks += FRAME_MAX_PARTS;
+  AccumulateTask* acc = calloc(n_tasks, sizeof(AccumulateTask));
+  n_tasks             = 0;
+  FOR(j, n_jobs) {
+    FrameJob* job = &jobs[j];
+    Mesh* m       = job->mesh;
+    job->failed   = !acc;
+    if (job->failed) continue;
+    int n_parts = (m->n_triangles + FRAME_PART_TRIANGLES - 1) /
+                  FRAME_PART_TRIANGLES;
+    if (n_parts > n_threads) n_parts = n_threads;
+    if (n_parts > FRAME_MAX_PARTS) n_parts = FRAME_MAX_PARTS;
+    if (n_parts < 1) n_parts = 1;
+
+    int per_part = (m->n_triangles + n_parts - 1) / n_parts;
+    FOR(p, n_parts) {
+      float* sum = calloc((size_t)m->n_vertices * width, sizeof(float));
+      if (!sum) {
+        // the parts already queued are freed once they are done
+        job->failed = true;
+        break;
+      }
+      int first = p * per_part;
+      int n     = m->n_triangles - first < per_part ? m->n_triangles - first
+                                                     : per_part;
+      job->parts[job->n_parts++] = sum;
+      acc[n_tasks]               = (AccumulateTask){m, pass, first, n, sum};
+      submitTask(pool, &group, accumulateTask, &acc[n_tasks++]);
+    }
+  }
+  waitTaskGroup(pool, &group);
+  free(acc);
+
+  // II. and are added up in ranges of vertices
+  n_tasks = 0;
+  FOR(j, n_jobs) {
+    n_tasks += (jobs[j].mesh->n_vertices + REDUCE_VERTICES - 1) /
+               REDUCE_VERTICES;
+  }
+  ReduceTask* red = calloc(n_tasks, sizeof(ReduceTask));
+  bool reduced    = red != NULL;
+  if (red) {
+    n_tasks = 0;
+    FOR(j, n_jobs) {
+      FrameJob* job = &jobs[j];
+      Mesh* m       = job->mesh;
+      // a partial sum would leave some vertices with the fallback frame
+      if (job->failed) continue;
+      for (int v = 0; v < m->n_vertices; v += REDUCE_VERTICES) {
+        int n = m->n_vertices - v < REDUCE_VERTICES ? m->n_vertices - v
+                                                    : REDUCE_VERTICES;
+        red[n_tasks] = (ReduceTask){
+            m, pass, job->parts, job->n_parts, v, n
+        };
+        submitTask(pool, &group, reduceTask, &red[n_tasks++]);
+      }
+    }
+    waitTaskGroup(pool, &group);
+    free(red);
+  }
+  FOR(j, n_jobs) {
+    FrameJob* job = &jobs[j];
+    // a mesh that could not be summed loses the attribute rather than
+    // keeping its zeros
+    if (!reduced || job->failed) *passField(job->mesh, pass) = NULL;
+    FOR(p, job->n_parts) free(job->parts[p]);
+    job->n_parts = 0;
+  }
+}
+
+void generateMeshFrames(Mesh* meshes, int n_meshes, Arena* arena) {
+  ThreadPool* pool = sharedThreadPool();
+  int n_threads    = pool ? pool->n_threads : 1;
+  FrameJob* jobs   = calloc(n_meshes, sizeof(FrameJob));
+  if (!jobs) return;
+
+  // normals first, the tangents are built against them
+  FramePass passes[] = {PASS_NORMALS, PASS_TANGENTS};
+  FOR(pi, 2) {
+    FramePass pass = passes[pi];
+    int n_jobs     = 0;
+    FOR(mi, n_meshes) {
+      Mesh* m = &meshes[mi];
+      if (!m->vertices || m->n_vertices == 0 || m->n_triangles == 0) continue;
+      if (pass == PASS_NORMALS && m->normals) continue;
+      if (pass == PASS_TANGENTS &&
+          (m->tangents || !m->tex_coords || !m->normals))
+        continue;
+
+      size_t n_floats = (size_t)m->n_vertices * (pass == PASS_NORMALS ? 3 : 4);
+      float* data     = arenaAllocAligned(
+          arena, n_floats * sizeof(float), MODEL_ALIGNMENT
+      );
+      memset(data, 0, n_floats * sizeof(float));
+      *passField(m, pass) = data;
+      jobs[n_jobs++] = (FrameJob){.mesh = m};
+    }
+    if (n_jobs) runPass(jobs, n_jobs, pass, n_threads);
+  }
+  free(jobs);
+}
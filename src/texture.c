@@ -1,34 +1,102 @@
 #include "textures/texture.h"
+#include "textures/mipmap.h"
+#include "textures/texture_cache.h"
 #include "external/stb_image.h"
 #include <stdbool.h>
+#include <stdlib.h>
 
-GLuint loadTexture(const char* fileName, ImageType type) {
-  int iw, ih, nbrChnls;
-  if (type == PNG) stbi_set_flip_vertically_on_load(true);
-  unsigned char* data = stbi_load(fileName, &iw, &ih, &nbrChnls, 0);
-  if (!data) return 0;
+bool compressedFormatSupported(GLenum format) {
+  static GLint* formats = NULL;
+  static GLint n        = -1;
+  if (n < 0) {
+    glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &n);
+    formats = malloc(n * sizeof(GLint));
+    if (!formats) n = 0;
+    if (n) glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats);
+  }
+  FOR(i, n) if ((GLenum)formats[i] == format) return true;
+  return false;
+}
+
+GLuint uploadImage(const ImageData* image, TextureUsage usage) {
+  if (!image->data) return 0;
   GLuint texture;
   glGenTextures(1, &texture);
   glBindTexture(GL_TEXTURE_2D, texture);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(
       GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR
   );
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexImage2D(
-      GL_TEXTURE_2D,
-      0,
-      GL_RGB,
-      iw,
-      ih,
-      0,
-      type == JPG ? GL_RGB : GL_RGBA,
-      GL_UNSIGNED_BYTE,
-      data
-  );
-  glGenerateMipmap(GL_TEXTURE_2D);
-  stbi_image_free(data);
+
+  // color textures are srgb encoded, their mips are filtered in linear
+  // space. The mips are built on the cpu, level by level.
+  bool srgb                = usage == TEXTURE_COLOR;
+  BlockFormat block_format = blockFormatFor(image->format, usage);
+  GLenum gl_format         = block_format_to_gl_const(block_format);
+  CompressedImage compressed;
+  if (COMPRESS_TEXTURES && compressedFormatSupported(gl_format) &&
+      loadCompressedImage(image, block_format, srgb, &compressed)) {
+    int max_level = compressed.n_levels - 1;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, max_level);
+    FOR(l, compressed.n_levels) {
+      glCompressedTexImage2D(
+          GL_TEXTURE_2D,
+          l,
+          gl_format,
+          mipSize(compressed.w, l),
+          mipSize(compressed.h, l),
+          0,
+          compressed.level_size[l],
+          compressed.data + compressed.level_offset[l]
+      );
+    }
+    freeCompressedImage(&compressed);
+    return texture;
+  }
+
+  // single and dual channel images are read as gray (+ alpha)
+  GLenum format = format_to_gl_const(image->format);
+  if (image->format == GRAY || image->format == GRAY_ALPHA) {
+    GLint alpha     = image->format == GRAY ? GL_ONE : GL_GREEN;
+    GLint swizzle[] = {GL_RED, GL_RED, GL_RED, alpha};
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  // the driver only builds the mips when the cpu chain could not be built
+  MipChain chain;
+  bool has_chain = buildMipChain(image, srgb, &chain);
+  if (has_chain)
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, chain.n_levels - 1);
+  else chain = (MipChain){.n_levels = 1, .levels = {*image}};
+  FOR(l, chain.n_levels) {
+    glTexImage2D(
+        GL_TEXTURE_2D,
+        l,
+        format,
+        chain.levels[l].w,
+        chain.levels[l].h,
+        0,
+        format,
+        GL_UNSIGNED_BYTE,
+        chain.levels[l].data
+    );
+  }
+  if (has_chain) freeMipChain(&chain);
+  else glGenerateMipmap(GL_TEXTURE_2D);
+  return texture;
+}
+
+GLuint loadTexture(const char* fileName, ImageType type) {
+  int iw, ih, nbrChnls;
+  if (type == PNG) stbi_set_flip_vertically_on_load(true);
+  unsigned char* data = stbi_load(fileName, &iw, &ih, &nbrChnls, 0);
   if (type == PNG) stbi_set_flip_vertically_on_load(false);
+  if (!data) return 0;
+  ImageData image = {.h = ih, .w = iw, .format = nbrChnls - 1, .data = data};
+  GLuint texture  = uploadImage(&image, TEXTURE_COLOR);
+  stbi_image_free(data);
   return texture;
 }
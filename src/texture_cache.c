@@ -0,0 +1,94 @@
+#include "textures/texture_cache.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+AssetKey hashImage(const ImageData* image) {
+  size_t size     = (size_t)image->w * image->h * (image->format + 1);
+  int32_t shape[] = {image->w, image->h, image->format};
+  AssetKey key    = hashAsset(image->data, size, (AssetKey){0});
+  return hashAsset(shape, sizeof(shape), key);
+}
+
+static bool readCache(const char* path, CompressedImage* out) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  TextureCacheHeader header;
+  bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+            header.magic == TEXTURE_CACHE_MAGIC &&
+            header.version == TEXTURE_CACHE_VERSION && header.w == out->w &&
+            header.h == out->h && header.format == (int32_t)out->format &&
+            header.n_levels == out->n_levels && header.size == out->size;
+  ok = ok && fread(out->data, 1, out->size, f) == out->size;
+  fclose(f);
+  return ok;
+}
+
+static void writeCache(const char* path, const CompressedImage* image) {
+  char tmp_path[1024];
+  FILE* f = beginAsset(path, tmp_path, sizeof(tmp_path));
+  if (!f) return;
+  TextureCacheHeader header = {
+      .magic    = TEXTURE_CACHE_MAGIC,
+      .version  = TEXTURE_CACHE_VERSION,
+      .w        = image->w,
+      .h        = image->h,
+      .format   = image->format,
+      .n_levels = image->n_levels,
+      .size     = image->size,
+  };
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+            fwrite(image->data, 1, image->size, f) == image->size;
+  endAsset(ASSET_TEXTURE, f, tmp_path, path, ok);
+}
+
+bool loadCompressedImage(
+    const ImageData* image, BlockFormat format, bool srgb,
+    CompressedImage* out
+) {
+  if (!image->data) return false;
+  *out          = (CompressedImage){0};
+  out->w        = image->w;
+  out->h        = image->h;
+  out->format   = format;
+  out->n_levels = mipLevelCount(image->w, image->h);
+  FOR(l, out->n_levels) {
+    out->level_offset[l] = out->size;
+    out->level_size[l]   = compressedSize(
+        format, mipSize(image->w, l), mipSize(image->h, l)
+    );
+    out->size += out->level_size[l];
+  }
+  out->data = malloc(out->size);
+  if (!out->data) return false;
+
+  // the same pixels filtered or compressed differently are another asset
+  int32_t settings[] = {TEXTURE_CACHE_VERSION, format, srgb};
+  AssetKey key = hashAsset(settings, sizeof(settings), hashImage(image));
+  char path[1024];
+  bool cached = assetPath(path, sizeof(path), ASSET_TEXTURE, key);
+  if (cached && readCache(path, out)) {
+    assetHit(ASSET_TEXTURE, path, out->size);
+    return true;
+  }
+  assetMiss(ASSET_TEXTURE);
+
+  // the levels are filtered from each other, and then compressed at once
+  LOG_INFO("> compressing %dx%d image\n", image->w, image->h);
+  MipChain chain;
+  if (!buildMipChain(image, srgb, &chain)) {
+    freeCompressedImage(out);
+    return false;
+  }
+  uint8_t* levels[MAX_MIP_LEVELS];
+  FOR(l, out->n_levels) levels[l] = out->data + out->level_offset[l];
+  compressImages(chain.levels, chain.n_levels, format, levels);
+  freeMipChain(&chain);
+  if (cached) writeCache(path, out);
+  return true;
+}
+
+void freeCompressedImage(CompressedImage* image) {
+  free(image->data);
+  image->data = NULL;
+}
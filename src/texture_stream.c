@@ -0,0 +1,342 @@
+#include "textures/texture_stream.h"
+#include "textures/mipmap.h"
+#include "textures/texture.h"
+#include "textures/texture_cache.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// nanoseconds `destroyTextureStream` waits for each upload in flight
+#define FENCE_TIMEOUT 1000000000ull
+
+static GLenum sizedFormat(ImageFormat format) {
+  switch (format) {
+  case GRAY: return GL_R8;
+  case GRAY_ALPHA: return GL_RG8;
+  case RED_GREEN_BLUE: return GL_RGB8;
+  default: return GL_RGBA8;
+  }
+}
+
+/// room for `c->size` bytes in the ring and a staging slot, false when the
+/// stream stops while waiting
+static bool reserveChunk(TextureStream* stream, StreamChunk* c) {
+  pthread_mutex_lock(&stream->lock);
+  for (;;) {
+    // a chunk never wraps, the end of the ring is skipped instead
+    bool wrap  = stream->head + c->size > STREAM_RING_SIZE;
+    size_t pad = wrap ? STREAM_RING_SIZE - stream->head : 0;
+    if (stream->stop) break;
+    if (stream->used + pad + c->size <= STREAM_RING_SIZE &&
+        stream->n_chunks < STREAM_MAX_CHUNKS) {
+      if (wrap) stream->head = 0;
+      c->offset  = stream->head;
+      c->release = pad + c->size;
+      stream->head += c->size;
+      stream->used += c->release;
+      pthread_mutex_unlock(&stream->lock);
+      return true;
+    }
+    pthread_cond_wait(&stream->changed, &stream->lock);
+  }
+  pthread_mutex_unlock(&stream->lock);
+  return false;
+}
+
+static void pushChunk(TextureStream* stream, const StreamChunk* c) {
+  pthread_mutex_lock(&stream->lock);
+  int i = (stream->chunk_head + stream->n_chunks) % STREAM_MAX_CHUNKS;
+  stream->chunks[i] = *c;
+  stream->n_chunks++;
+  pthread_mutex_unlock(&stream->lock);
+}
+
+/// builds the levels of `t` and copies them into the ring, smallest first
+static void stageTexture(TextureStream* stream, StreamTexture* t) {
+  const ImageData* image = &t->image;
+  bool srgb              = t->usage == TEXTURE_COLOR;
+  CompressedImage compressed;
+  MipChain chain;
+  bool ok =
+      t->compressed
+          ? loadCompressedImage(image, t->block_format, srgb, &compressed)
+          : buildMipChain(image, srgb, &chain);
+  if (!ok) {
+    LOG(
+        LOG_LEVEL_ERROR, "> could not stream %dx%d image\n", image->w, image->h
+    );
+    return;
+  }
+
+  int n_ch = image->format + 1;
+  for (int l = t->n_levels - 1; l >= 0; l--) {
+    int w = mipSize(image->w, l);
+    int h = mipSize(image->h, l);
+
+    // chunks are whole rows, whole rows of blocks when compressed
+    int unit            = t->compressed ? 4 : 1;
+    size_t row_size     = t->compressed ? compressedSize(t->block_format, w, 4)
+                                        : (size_t)w * n_ch;
+    const uint8_t* data = t->compressed
+                              ? compressed.data + compressed.level_offset[l]
+                              : chain.levels[l].data;
+    int n_rows          = (h + unit - 1) / unit;
+    int rows_per_chunk  = STREAM_CHUNK_SIZE / row_size;
+    if (rows_per_chunk < 1) rows_per_chunk = 1;
+
+    for (int r = 0; r < n_rows; r += rows_per_chunk) {
+      int n = n_rows - r < rows_per_chunk ? n_rows - r : rows_per_chunk;
+      StreamChunk c = {
+          .texture = t,
+          .level   = l,
+          .y       = r * unit,
+          .w       = w,
+          .h       = n * unit < h - r * unit ? n * unit : h - r * unit,
+          .size    = n * row_size,
+          .last    = r + n == n_rows,
+      };
+      if (!reserveChunk(stream, &c)) goto clean;
+      memcpy(stream->ring + c.offset, data + r * row_size, c.size);
+      pushChunk(stream, &c);
+    }
+  }
+
+clean:
+  if (t->compressed) freeCompressedImage(&compressed);
+  else freeMipChain(&chain);
+}
+
+static void* streamWorker(void* arg) {
+  TextureStream* stream = arg;
+  pthread_mutex_lock(&stream->lock);
+  for (;;) {
+    while (!stream->requests && !stream->stop)
+      pthread_cond_wait(&stream->changed, &stream->lock);
+    if (stream->stop) break;
+
+    StreamTexture* t = stream->requests;
+    stream->requests = t->next;
+    if (!stream->requests) stream->requests_tail = NULL;
+
+    pthread_mutex_unlock(&stream->lock);
+    stageTexture(stream, t);
+    pthread_mutex_lock(&stream->lock);
+
+    t->next      = stream->done;
+    stream->done = t;
+    stream->n_busy--;
+  }
+  pthread_mutex_unlock(&stream->lock);
+  return NULL;
+}
+
+TextureStream* createTextureStream(void) {
+  // persistent mappings and the direct state access calls
+  if (!GLAD_GL_VERSION_4_5) return NULL;
+  TextureStream* stream = calloc(1, sizeof(TextureStream));
+  if (!stream) return NULL;
+
+  GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glCreateBuffers(1, &stream->pbo);
+  glNamedBufferStorage(stream->pbo, STREAM_RING_SIZE, NULL, flags);
+  stream->ring =
+      glMapNamedBufferRange(stream->pbo, 0, STREAM_RING_SIZE, flags);
+  if (!stream->ring) {
+    glDeleteBuffers(1, &stream->pbo);
+    free(stream);
+    return NULL;
+  }
+
+  pthread_mutex_init(&stream->lock, NULL);
+  pthread_cond_init(&stream->changed, NULL);
+  if (pthread_create(&stream->worker, NULL, streamWorker, stream)) {
+    glUnmapNamedBuffer(stream->pbo);
+    glDeleteBuffers(1, &stream->pbo);
+    pthread_mutex_destroy(&stream->lock);
+    pthread_cond_destroy(&stream->changed);
+    free(stream);
+    return NULL;
+  }
+  return stream;
+}
+
+void destroyTextureStream(TextureStream* stream) {
+  pthread_mutex_lock(&stream->lock);
+  stream->stop = true;
+  pthread_cond_broadcast(&stream->changed);
+  pthread_mutex_unlock(&stream->lock);
+  pthread_join(stream->worker, NULL);
+
+  // the gpu may still read from the ring
+  while (stream->n_fences) {
+    StreamFence* f = &stream->fences[stream->fence_head];
+    glClientWaitSync(f->fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+    glDeleteSync(f->fence);
+    stream->fence_head = (stream->fence_head + 1) % STREAM_MAX_FENCES;
+    stream->n_fences--;
+  }
+  glUnmapNamedBuffer(stream->pbo);
+  glDeleteBuffers(1, &stream->pbo);
+
+  StreamTexture* lists[] = {stream->requests, stream->done};
+  FOR(i, 2) {
+    for (StreamTexture* t = lists[i]; t;) {
+      StreamTexture* next = t->next;
+      free(t);
+      t = next;
+    }
+  }
+  pthread_mutex_destroy(&stream->lock);
+  pthread_cond_destroy(&stream->changed);
+  free(stream);
+}
+
+GLuint streamImage(
+    TextureStream* stream, const ImageData* image, TextureUsage usage
+) {
+  if (!image->data) return 0;
+  StreamTexture* t = calloc(1, sizeof(StreamTexture));
+  if (!t) return 0;
+  t->image        = *image;
+  t->usage        = usage;
+  t->n_levels     = mipLevelCount(image->w, image->h);
+  t->block_format = blockFormatFor(image->format, usage);
+  GLenum format   = block_format_to_gl_const(t->block_format);
+  t->compressed   = COMPRESS_TEXTURES && compressedFormatSupported(format);
+  if (!t->compressed) format = sizedFormat(image->format);
+
+  // the storage exists up front, the levels fill in as they arrive
+  GLuint tex;
+  glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+  glTextureStorage2D(tex, t->n_levels, format, image->w, image->h);
+  glTextureParameteri(tex, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTextureParameteri(tex, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTextureParameteri(tex, GL_TEXTURE_BASE_LEVEL, t->n_levels - 1);
+  if (!t->compressed &&
+      (image->format == GRAY || image->format == GRAY_ALPHA)) {
+    GLint alpha     = image->format == GRAY ? GL_ONE : GL_GREEN;
+    GLint swizzle[] = {GL_RED, GL_RED, GL_RED, alpha};
+    glTextureParameteriv(tex, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+  }
+  t->texture = tex;
+
+  pthread_mutex_lock(&stream->lock);
+  if (stream->requests_tail) stream->requests_tail->next = t;
+  else stream->requests = t;
+  stream->requests_tail = t;
+  stream->n_busy++;
+  pthread_cond_broadcast(&stream->changed);
+  pthread_mutex_unlock(&stream->lock);
+  return tex;
+}
+
+/// frees the textures on the done list that no staged chunk refers to,
+/// with the lock held. Their pixels were copied into the ring already.
+static void releaseDone(TextureStream* stream) {
+  StreamTexture** link = &stream->done;
+  while (*link) {
+    StreamTexture* t = *link;
+    bool staged      = false;
+    for (int k = 0; k < stream->n_chunks && !staged; k++) {
+      int i  = (stream->chunk_head + k) % STREAM_MAX_CHUNKS;
+      staged = stream->chunks[i].texture == t;
+    }
+    if (staged) {
+      link = &t->next;
+    } else {
+      *link = t->next;
+      free(t);
+    }
+  }
+}
+
+void pumpTextureStream(TextureStream* stream) {
+  // I. ring space of uploads the gpu is done with
+  size_t released = 0;
+  while (stream->n_fences) {
+    StreamFence* f = &stream->fences[stream->fence_head];
+    GLenum state   = glClientWaitSync(f->fence, 0, 0);
+    if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+      break;
+    glDeleteSync(f->fence);
+    released += f->release;
+    stream->fence_head = (stream->fence_head + 1) % STREAM_MAX_FENCES;
+    stream->n_fences--;
+  }
+
+  // II. the staged chunks that fit in this frame's budget
+  StreamChunk batch[STREAM_MAX_CHUNKS];
+  int n        = 0;
+  size_t bytes = 0;
+  pthread_mutex_lock(&stream->lock);
+  stream->used -= released;
+  // before taking the batch, whose chunks are uploaded after the unlock
+  releaseDone(stream);
+  while (stream->n_chunks && bytes < STREAM_FRAME_BUDGET &&
+         stream->n_fences < STREAM_MAX_FENCES) {
+    batch[n] = stream->chunks[stream->chunk_head];
+    bytes += batch[n++].size;
+    stream->chunk_head = (stream->chunk_head + 1) % STREAM_MAX_CHUNKS;
+    stream->n_chunks--;
+  }
+  if (released || n) pthread_cond_broadcast(&stream->changed);
+  pthread_mutex_unlock(&stream->lock);
+  if (!n) return;
+
+  // III. upload straight from the ring and fence the whole batch
+  size_t release = 0;
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream->pbo);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  FOR(i, n) {
+    StreamChunk* c   = &batch[i];
+    StreamTexture* t = c->texture;
+    const void* src  = (const void*)(uintptr_t)c->offset;
+    if (t->compressed) {
+      glCompressedTextureSubImage2D(
+          t->texture,
+          c->level,
+          0,
+          c->y,
+          c->w,
+          c->h,
+          block_format_to_gl_const(t->block_format),
+          c->size,
+          src
+      );
+    } else {
+      glTextureSubImage2D(
+          t->texture,
+          c->level,
+          0,
+          c->y,
+          c->w,
+          c->h,
+          format_to_gl_const(t->image.format),
+          GL_UNSIGNED_BYTE,
+          src
+      );
+    }
+    // levels complete from the smallest up, each one can be sampled now
+    if (c->last)
+      glTextureParameteri(t->texture, GL_TEXTURE_BASE_LEVEL, c->level);
+    release += c->release;
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  int i = (stream->fence_head + stream->n_fences) % STREAM_MAX_FENCES;
+  stream->fences[i] =
+      (StreamFence){glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), release};
+  stream->n_fences++;
+}
+
+bool textureStreamIdle(TextureStream* stream) {
+  pthread_mutex_lock(&stream->lock);
+  // staged chunks still name their texture
+  bool idle = !stream->n_busy && !stream->n_chunks;
+  pthread_mutex_unlock(&stream->lock);
+  return idle;
+}
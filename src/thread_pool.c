@@ -0,0 +1,133 @@
+#define _DEFAULT_SOURCE
+#include "thread_pool.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+#define INITIAL_QUEUE_CAPACITY 64
+
+static void* workerMain(void* arg) {
+  ThreadPool* pool = arg;
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->count && !pool->stop)
+      pthread_cond_wait(&pool->has_work, &pool->lock);
+    if (!pool->count && pool->stop) break;
+
+    Task task  = pool->queue[pool->head];
+    pool->head = (pool->head + 1) % pool->capacity;
+    pool->count--;
+
+    pthread_mutex_unlock(&pool->lock);
+    task.fn(task.arg);
+    pthread_mutex_lock(&pool->lock);
+
+    bool wake = --pool->pending == 0;
+    if (task.group) wake |= --task.group->pending == 0;
+    if (wake) pthread_cond_broadcast(&pool->idle);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+ThreadPool* createThreadPool(int n_threads) {
+  if (n_threads <= 0) n_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (n_threads <= 0) n_threads = 1;
+
+  ThreadPool* pool = calloc(1, sizeof(ThreadPool));
+  if (!pool) return NULL;
+  pool->threads  = calloc(n_threads, sizeof(pthread_t));
+  pool->queue    = calloc(INITIAL_QUEUE_CAPACITY, sizeof(Task));
+  pool->capacity = INITIAL_QUEUE_CAPACITY;
+  if (!pool->threads || !pool->queue) {
+    free(pool->threads);
+    free(pool->queue);
+    free(pool);
+    return NULL;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->has_work, NULL);
+  pthread_cond_init(&pool->idle, NULL);
+
+  for (int i = 0; i < n_threads; i++) {
+    if (pthread_create(&pool->threads[i], NULL, workerMain, pool)) break;
+    pool->n_threads++;
+  }
+  if (!pool->n_threads) {
+    destroyThreadPool(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+void destroyThreadPool(ThreadPool* pool) {
+  if (!pool) return;
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = true;
+  pthread_cond_broadcast(&pool->has_work);
+  pthread_mutex_unlock(&pool->lock);
+  for (int i = 0; i < pool->n_threads; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->has_work);
+  pthread_cond_destroy(&pool->idle);
+  free(pool->threads);
+  free(pool->queue);
+  free(pool);
+}
+
+void submitTask(ThreadPool* pool, TaskGroup* group, TaskFn fn, void* arg) {
+  // without a pool the work is simply done inline
+  if (!pool) {
+    fn(arg);
+    return;
+  }
+  pthread_mutex_lock(&pool->lock);
+  if (pool->count == pool->capacity) {
+    // grow and unwrap the ring buffer
+    int capacity = pool->capacity * 2;
+    Task* queue  = malloc(capacity * sizeof(Task));
+    if (!queue) {
+      pthread_mutex_unlock(&pool->lock);
+      fn(arg);
+      return;
+    }
+    for (int i = 0; i < pool->count; i++)
+      queue[i] = pool->queue[(pool->head + i) % pool->capacity];
+    free(pool->queue);
+    pool->queue    = queue;
+    pool->capacity = capacity;
+    pool->head     = 0;
+  }
+  pool->queue[(pool->head + pool->count) % pool->capacity] =
+      (Task){fn, arg, group};
+  pool->count++;
+  pool->pending++;
+  if (group) group->pending++;
+  pthread_cond_signal(&pool->has_work);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void waitThreadPool(ThreadPool* pool) {
+  if (!pool) return;
+  pthread_mutex_lock(&pool->lock);
+  while (pool->pending) pthread_cond_wait(&pool->idle, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void waitTaskGroup(ThreadPool* pool, TaskGroup* group) {
+  if (!pool) return;
+  pthread_mutex_lock(&pool->lock);
+  while (group->pending) pthread_cond_wait(&pool->idle, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static ThreadPool* shared_pool = NULL;
+static pthread_once_t shared_pool_once = PTHREAD_ONCE_INIT;
+
+static void initSharedThreadPool(void) { shared_pool = createThreadPool(0); }
+
+ThreadPool* sharedThreadPool(void) {
+  pthread_once(&shared_pool_once, initSharedThreadPool);
+  return shared_pool;
+}